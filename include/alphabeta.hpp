@@ -22,116 +22,543 @@
 
 #include <iostream>
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 //class AlphaBetaDebug;
 
+// what a cached score says about the true value: exact, at most (the
+// search failed low) or at least (it failed high)
+enum Bound : unsigned char { NO_BOUND = 0, UPPER_BOUND = 1, LOWER_BOUND = 2, EXACT_BOUND = 3 };
+
+// score for player 0, depth = plies searched below the position,
+// move = best column found or -1
+template<class Score>
+struct CacheEntry
+{
+    Score score;
+    int depth;
+    Bound bound;
+    int move;
+};
+
 template<class State>
 struct NoPolicy
 {
     using Score = typename State::score_type;
-    void insert(State, Score, int) { }
-    std::pair<Score,bool> lookup(State, int) { return std::make_pair(Score(),false); }
+    using Entry = CacheEntry<Score>;
+    void insert(State, Entry) { }
+    Entry lookup(State) const { return Entry{Score(), 0, NO_BOUND, -1}; }
 };
 
+// the move of mirrored positions sharing an entry is stored mirrored
+template<class State>
+int canonical_move(State s, int move)
+{
+    return move >= 0 && s.is_mirrored_key() ? State::mirror_column(move) : move;
+}
+
 template<class State>
 struct DefaultPolicy
 {
     using Score = typename State::score_type;
+    using Entry = CacheEntry<Score>;
+
+    // mirror images share an entry (same score, columns mirrored)
+    Entry lookup(State s) const {
+        auto it = _cache.find(s.canonical_key());
+        if (it == _cache.end()) return Entry{Score(), 0, NO_BOUND, -1};
+        Entry e = (*it).second;
+        e.move = canonical_move(s, e.move);
+        return e;
+    }
+
+    // a deeper entry for the same position stays
+    void insert(State s, Entry e) {
+        e.move = canonical_move(s, e.move);
+        auto res = _cache.emplace(s.canonical_key(), e);
+        if (!res.second && (*res.first).second.depth <= e.depth) (*res.first).second = e;
+    }
+
+    size_t size() const { return _cache.size(); }
 
-    struct CacheEntry
+private:
+    std::unordered_map<typename State::board_type,Entry,typename State::KeyHasher> _cache;
+};
+
+// evaluates every leaf from scratch
+template<class State>
+struct FullEval
+{
+    struct Acc { };
+    Acc root(const State&) const { return Acc(); }
+    Acc move(Acc, const State&, const State&) const { return Acc(); }
+    auto operator()(const State& s, Acc) const { return s(); }
+};
+
+// carries State::Eval down the tree, updated by each move
+template<class State>
+struct IncrementalEval
+{
+    using Acc = typename State::Eval;
+    Acc root(const State& s) const { return s.eval(); }
+    Acc move(Acc e, const State& parent, const State& child) const
     {
-        Score score;
-        int depth;
-    };
+        return parent.eval_move(e, child.last_column());
+    }
+    auto operator()(const State& s, Acc e) const { return s(e); }
+};
 
-    std::pair<Score,bool> lookup(State s, int depth) const {
-        auto it = _cache.find(s);
-        if (it == _cache.end())
-        {
-            State sym = s.symmetric();
-            it = _cache.find(sym);
-            if (it == _cache.end())
-            {
-                return std::make_pair(Score(), false);
+// exact values, for searches to the end of the game: those of finished
+// games only (State::win_value()), a game still on at depth 0 is worth 0
+template<class State>
+struct SolverEval
+{
+    struct Acc { };
+    Acc root(const State&) const { return Acc(); }
+    Acc move(Acc, const State&, const State&) const { return Acc(); }
+    auto operator()(const State& s, Acc) const
+    {
+        const int w = s.winner();
+        if (w > 1) return typename State::score_type(0);
+        return w == 0 ? s.win_value(0) : -s.win_value(0);
+    }
+};
+
+// Move ordering learnt while searching: two killer columns per ply (the
+// last moves to cause a cutoff there) and a history score per player,
+// column and landing row, raised by depth^2 for a move that cuts off and
+// lowered as much for those tried before it.  It carries over from one
+// iterative-deepening iteration (and move) to the next; clear() it for a
+// new game.
+template<class State>
+class MoveOrdering
+{
+public:
+    using move_list = typename State::move_list;
+
+    MoveOrdering() { clear(); }
+
+    void clear()
+    {
+        for (auto& k: _killer) k[0] = k[1] = -1;
+        for (auto& h: _history) for (auto& c: h) for (int& x: c) x = 0;
+    }
+
+    // the cached move, the first of cols (as sorted_moves() leaves them:
+    // the most threats), the killers, then the rest by history; an
+    // immediate win (first in sorted_moves()) is left alone
+    void order(const State& s, move_list& cols, int cached) const
+    {
+        const int who = s.next_player();
+        if (cols.size() < 2 || s.make_move(cols[0], who).last_move_wins()) return;
+        const int* killer = _killer[ply(s)];
+        int key[State::WIDTH];
+        for (size_t i = 0; i < cols.size(); ++i) {
+            const int col = cols[i];
+            key[i] = col == cached ? 1<<30
+                   : i == 0 ? 1<<29
+                   : col == killer[0] ? 1<<28
+                   : col == killer[1] ? 1<<27
+                   : _history[who][col][s.column_height(col)];
+        }
+        for (size_t i = 1; i < cols.size(); ++i)
+            for (size_t j = i; j > 0 && key[j] > key[j-1]; --j) {
+                std::swap(key[j], key[j-1]);
+                std::swap(cols[j], cols[j-1]);
             }
+    }
+
+    // col cut off after the moves before it in cols
+    void cutoff(const State& s, const move_list& cols, int col, int depth)
+    {
+        int* killer = _killer[ply(s)];
+        if (killer[0] != col) killer[1] = killer[0], killer[0] = col;
+        const int who = s.next_player();
+        for (int c: cols) {
+            int& h = _history[who][c][s.column_height(c)];
+            h += c == col ? depth*depth : -depth*depth;
+            // either way, so that a table kept across searches cannot overflow
+            if (std::abs(h) > HISTORY_MAX)
+                for (auto& x: _history) for (auto& y: x) for (int& v: y) v /= 2;
+            if (c == col) break;
         }
-//        if ((*it).second.depth != depth) return std::make_pair(Score(), false);
-        if ((*it).second.depth > depth) return std::make_pair(Score(), false);
-        return std::make_pair((*it).second.score, true);
     }
 
-    void insert(State s, typename State::score_type score, int depth) { _cache[s] = CacheEntry{score, depth}; }
+private:
+    static constexpr int HISTORY_MAX = 1<<24;
+
+    static int ply(const State& s) { return State::MAX_DEPTH - s.empty_space(); }
+
+    int _killer[State::MAX_DEPTH][2];
+    int _history[2][State::WIDTH][State::HEIGHT];
+};
+
+// thrown by negamax when a search runs past its deadline
+struct SearchTimeout { };
+
+// raised by another thread to stop a search; raising a flag also raises
+// those that have it for parent (the searches nested in one)
+struct StopFlag
+{
+    std::atomic<bool> raised{false};
+    const StopFlag *parent = 0;
+
+    bool is_raised() const
+    {
+        for (const StopFlag *f = this; f; f = f->parent)
+            if (f->raised.load(std::memory_order_relaxed)) return true;
+        return false;
+    }
+};
+
+// wall-clock limit of a search, looked at every 1024 nodes, along with a
+// flag another thread may raise to stop it early
+class Deadline
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    explicit Deadline(clock_type::time_point at, const StopFlag *stop = 0): _at(at), _stop(stop) { }
+
+    static clock_type::time_point after(double seconds)
+    {
+        return clock_type::now()
+               + std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(seconds));
+    }
+
+    void check()
+    {
+        if ((++_ticks & 1023) == 0 &&
+            ((_stop && _stop->is_raised()) || clock_type::now() >= _at))
+            throw SearchTimeout();
+    }
 
 private:
-    std::unordered_map<State,CacheEntry,typename State::Hasher> _cache;
+    clock_type::time_point _at;
+    const StopFlag *_stop;
+    unsigned _ticks = 0;
 };
 
-template<class State, class CachingPolicy>
-typename State::score_type alpha_beta_cache(State s, CachingPolicy &cache, typename State::score_type alpha, typename State::score_type beta,
-                                        bool max, bool second_player, int max_depth, int cur_depth = 0, State *best = 0, int *moves = 0)
+// player 0's score and bound as seen by Side (and back)
+template<int Side, class Score>
+Score side_score(Score v) { return Side ? -v : v; }
+
+template<int Side>
+Bound side_bound(Bound b) { return Side && (b == UPPER_BOUND || b == LOWER_BOUND) ? Bound(b ^ 3) : b; }
+
+// a cache entry for the node s, from the point of view of Side
+template<int Side, class State, class CachingPolicy>
+void store_node(CachingPolicy &cache, State s, typename State::score_type v, Bound b, int depth, int move)
+{
+    cache.insert(s, CacheEntry<typename State::score_type>{side_score<Side>(v), depth, side_bound<Side>(b), move});
+}
+
+// What negamax does before searching the moves: true, with *v, if a leaf,
+// the cache, a finished game, the mate distance or a game lost in two
+// plies settles the node; otherwise the moves to search are left in *cols,
+// in order, and the window (*alpha, *beta) is narrowed to the scores still
+// possible.  At the root (the move is wanted), only a leaf or a finished
+// game settles it.
+// Short of an immediate win, a move under (or beside) an opponent's win
+// loses at once and is left out.
+template<int Side, class State, class CachingPolicy, class Evaluation>
+bool settle(State s, typename Evaluation::Acc acc, const Evaluation& eval, CachingPolicy &cache,
+            typename State::score_type *alpha, typename State::score_type *beta, int depth, bool root,
+            MoveOrdering<State> *ordering, typename State::score_type *v, typename State::move_list *cols)
 {
-//    AlphaBetaDebug foo(max,cur_depth);
-    auto res = cache.lookup(s, cur_depth);
-    if (res.second) {
-//        std::cerr << "cache hit for state! " << s.hash_value() << std::endl;
-        return second_player ? -res.first : res.first;
+    // leaves are cheaper to evaluate than to look up
+    if (depth == 0)
+    {
+        *v = side_score<Side>(eval(s, acc));
+        return true;
+    }
+    auto hit = cache.lookup(s);
+    const Bound bound = side_bound<Side>(hit.bound);
+    if (bound != NO_BOUND && hit.depth >= depth && !root) {
+        *v = side_score<Side>(hit.score);
+        if (bound == EXACT_BOUND || (bound == LOWER_BOUND && *v >= *beta) || (bound == UPPER_BOUND && *v <= *alpha))
+            return true;
     }
-    if (cur_depth == max_depth || s.is_terminal())
+    if (s.is_terminal())
     {
-        //typename State::score_type score = s()*(3.0/(3.0+cur_depth));
-        auto score = s();
-        cache.insert(s, score, cur_depth);
-        return second_player ? -score : score;
-    }
-    State sa, sb;
-    typename State::iterator it(s);
-    while (it.hasNext())
+        *v = side_score<Side>(eval(s, acc));
+        // a finished game is final however deep it is searched
+        store_node<Side>(cache, s, *v, EXACT_BOUND, State::MAX_DEPTH, -1);
+        return true;
+    }
+    // mate distance: no win before the next move, no loss before the reply
+    if (!root)
     {
-        State r = it.next();
-        if (moves)
+        *alpha = std::max(*alpha, -s.win_value(2));
+        *beta = std::min(*beta, s.win_value(1));
+        if (*alpha >= *beta)
         {
-            ++(*moves);
-//            if (((*moves) & ((1<<20)-1)) == 0) std::cerr << (*moves) << std::endl;
+            *v = *alpha;
+            return true;
         }
-//        r.dump(std::cerr);
-        auto val = alpha_beta_cache<State>(r, cache, alpha, beta, !max, second_player,
-                                                          max_depth, cur_depth+1, 0, moves);
-//        std::cerr << val << std::endl;
-        if (max)
+    }
+    *cols = s.sorted_moves();
+    if (!(s.playable() & s.winning_cells(Side)))
+    {
+        const auto safe = s.non_losing_moves();
+        if (safe) *cols = State::filter_moves(*cols, safe);
+        else if (!root)
         {
-            if (val > alpha) alpha = val, sa = r;
-            if (beta <= alpha)
-            {
-                if (best) *best = sa;
-                cache.insert(r, second_player ? -alpha : alpha, cur_depth);
-                return alpha;
-            }
+            *v = -s.win_value(2);
+            store_node<Side>(cache, s, *v, EXACT_BOUND, State::MAX_DEPTH, -1);
+            return true;
         }
+    }
+    const int cached = bound != NO_BOUND ? hit.move : -1;
+    if (ordering) ordering->order(s, *cols, cached);
+    else if (cached >= 0) {
+        auto it = std::find(cols->begin(), cols->end(), cached);
+        if (it != cols->end()) std::rotate(cols->begin(), it, it+1);
+    }
+    return false;
+}
+
+// the cache entry for a node searched with the window (alpha0, beta)
+template<int Side, class State, class CachingPolicy>
+void store_result(CachingPolicy &cache, State s, typename State::score_type best_score,
+                  typename State::score_type alpha0, typename State::score_type beta, int depth, State best_state)
+{
+    if (best_score <= alpha0) store_node<Side>(cache, s, best_score, UPPER_BOUND, depth, -1);
+    else store_node<Side>(cache, s, best_score, best_score >= beta ? LOWER_BOUND : EXACT_BOUND, depth,
+                          best_state.last_column());
+}
+
+// Negamax with principal variation search: the first move gets the full
+// window, the others a null window above alpha and a full re-search only
+// if they beat it (scores are integers).  Side is the player to move, fixed
+// at compile time; the result is fail-soft and for Side.  Cache entries are
+// for player 0, so they serve both sides and any root.  An entry answers
+// the node if it was searched at least as deep and its bound settles the
+// window; otherwise its move is tried first.  Not at the root (best != 0),
+// which has to find its move.  With a deadline, the search may end by
+// SearchTimeout; whatever it stored in the cache by then is complete.
+// Moves come in the order of sorted_moves(); with an ordering, they are
+// sorted by it instead and cutoffs teach it.
+template<int Side, class State, class CachingPolicy, class Evaluation>
+typename State::score_type negamax(State s, typename Evaluation::Acc acc, const Evaluation& eval, CachingPolicy &cache,
+                                   typename State::score_type alpha, typename State::score_type beta,
+                                   int depth, State *best, int *moves, Deadline *deadline = 0,
+                                   MoveOrdering<State> *ordering = 0)
+{
+    if (deadline) deadline->check();
+    using Score = typename State::score_type;
+    Score v;
+    typename State::move_list cols;
+    if (settle<Side>(s, acc, eval, cache, &alpha, &beta, depth, best != 0, ordering, &v, &cols)) return v;
+    const Score alpha0 = alpha;
+    Score best_score = State::MINUS_INFINITY;
+    State best_state;
+    for (int col: cols)
+    {
+        State r = s.make_move(col, Side);
+        if (moves) ++(*moves);
+        const auto racc = eval.move(acc, s, r);
+        Score val;
+        if (col == cols.front())
+            val = -negamax<1-Side>(r, racc, eval, cache, -beta, -alpha, depth-1, (State*)0, moves, deadline, ordering);
         else
         {
-            if (val < beta) beta = val, sb = r;
-            if (beta <= alpha)
+            val = -negamax<1-Side>(r, racc, eval, cache, -alpha-1, -alpha, depth-1, (State*)0, moves, deadline, ordering);
+            if (alpha < val && val < beta)
+                val = -negamax<1-Side>(r, racc, eval, cache, -beta, -alpha, depth-1, (State*)0, moves, deadline, ordering);
+        }
+        if (val > best_score) best_score = val, best_state = r;
+        if (val > alpha) alpha = val;
+        if (alpha >= beta)
+        {
+            if (ordering && !r.last_move_wins()) ordering->cutoff(s, cols, col, depth);
+            break;
+        }
+    }
+    if (best) *best = best_state;
+    store_result<Side>(cache, s, best_score, alpha0, beta, depth, best_state);
+    return best_score;
+}
+
+// The exact value (SolverEval) of s for the player to move, by MTD(f):
+// null-window searches to the end of the game, each telling whether the
+// value is above a guess and returning a bound that narrows the range and
+// makes the next guess.  The first guess is 0 (win, draw or loss).  The
+// cache carries the work of one search over to the next; it must not hold
+// values of another evaluation.  best gets a move of that value.
+template<class State, class CachingPolicy>
+typename State::score_type solve(State s, CachingPolicy &cache, State *best = 0, int *moves = 0)
+{
+    using Score = typename State::score_type;
+    SolverEval<State> eval;
+    const int depth = s.empty_space();
+    Score lo = -Score(State::WIN_SCORE + depth), hi = Score(State::WIN_SCORE + depth), guess = 0;
+    bool found = false;
+    while (lo < hi)
+    {
+        State q;
+        const Score v = s.next_player()
+            ? negamax<1>(s, eval.root(s), eval, cache, guess, guess+1, depth, &q, moves)
+            : negamax<0>(s, eval.root(s), eval, cache, guess, guess+1, depth, &q, moves);
+        if (v > guess)
+        {
+            lo = guess = v;
+            found = true;
+            if (best) *best = q;
+        }
+        else
+        {
+            hi = v;
+            guess = v-1;
+            if (best && !found) *best = q;
+        }
+    }
+    return lo;
+}
+
+// the old interface: scores for player second_player, who is the one to
+// move if max; with SolverEval to the end of the game, the exact value by
+// solve(), which suits any window
+template<class State, class CachingPolicy, class Evaluation = FullEval<State> >
+typename State::score_type alpha_beta_cache(State s, CachingPolicy &cache, typename State::score_type alpha, typename State::score_type beta,
+                                        bool max, bool second_player, int max_depth, int cur_depth = 0, State *best = 0, int *moves = 0,
+                                        MoveOrdering<State> *ordering = 0)
+{
+    Evaluation eval;
+    const int depth = max_depth - cur_depth;
+    if (!max) return -alpha_beta_cache<State,CachingPolicy,Evaluation>(s, cache, -beta, -alpha, true, !second_player,
+                                                                       max_depth, cur_depth, best, moves, ordering);
+    if constexpr (std::is_same_v<Evaluation, SolverEval<State>>)
+        if (depth >= s.empty_space()) return solve(s, cache, best, moves);
+    return second_player ? negamax<1>(s, eval.root(s), eval, cache, alpha, beta, depth, best, moves, 0, ordering)
+                         : negamax<0>(s, eval.root(s), eval, cache, alpha, beta, depth, best, moves, 0, ordering);
+}
+
+// half-width of the aspiration windows of iterative deepening, 0: none
+constexpr int ASPIRATION = 4;
+
+// Searches depth first_depth, first_depth+step, ... max_depth (at most to
+// the end of the game) until the deadline, each iteration ordering the next
+// through the best moves it leaves in the cache.  An iteration cut short
+// by the deadline is dropped; depth 1 completes regardless if exempt_first.
+// With an aspiration, each iteration opens with the window of that
+// half-width around the score of two plies less (the last one of the same
+// parity: scores swing with the side that moves last), unless a win or
+// loss; on failing low or high it widens that side twofold and searches
+// again.
+// After each completed depth, report(depth, score, best, nodes).  Returns
+// the score of the deepest completed search, for the player to move.
+template<class State, class CachingPolicy, class Evaluation, class Report>
+typename State::score_type deepen(State s, CachingPolicy &cache, Deadline &deadline,
+                                  int first_depth, int step, int max_depth, bool exempt_first,
+                                  State *best, int *moves, Report report, MoveOrdering<State> *ordering,
+                                  int aspiration)
+{
+    using Score = typename State::score_type;
+    Evaluation eval;
+    Score score = 0;
+    Score last[2] = {0, 0}; // by parity of depth
+    max_depth = std::min(max_depth, s.empty_space());
+    for (int depth = first_depth; depth <= max_depth; depth += step)
+    {
+        State q;
+        int nodes = 0;
+        Deadline *limit = depth > 1 || !exempt_first ? &deadline : 0;
+        Score alpha = State::MINUS_INFINITY, beta = State::PLUS_INFINITY, delta = aspiration;
+        const Score guess = last[depth & 1];
+        if (aspiration && depth-2 >= first_depth && std::abs(guess) < State::WIN_SCORE)
+            alpha = guess - delta, beta = guess + delta;
+        try {
+            // a bound until inside the window; score keeps the last
+            // completed depth should a re-search run out of time
+            while (true)
             {
-                if (best) *best = sb;
-                cache.insert(r, second_player ? -beta : beta, cur_depth);
-                return beta;
+                const Score v = s.next_player()
+                    ? negamax<1>(s, eval.root(s), eval, cache, alpha, beta, depth, &q, &nodes, limit, ordering)
+                    : negamax<0>(s, eval.root(s), eval, cache, alpha, beta, depth, &q, &nodes, limit, ordering);
+                if (v > alpha && v < beta) {
+                    score = v;
+                    break;
+                }
+                delta *= 2;
+                if (v <= alpha) alpha = delta < State::WIN_SCORE ? v - delta : Score(State::MINUS_INFINITY);
+                else beta = delta < State::WIN_SCORE ? v + delta : Score(State::PLUS_INFINITY);
             }
+        } catch (const SearchTimeout&) {
+            if (moves) *moves += nodes;
+            break;
         }
+        if (moves) *moves += nodes;
+        if (best) *best = q;
+        last[depth & 1] = score;
+        report(depth, score, q, nodes);
     }
-    if (best) *best = max ? sa : sb;
-    auto rval = max ? alpha: beta;
-    cache.insert(s, second_player ? -rval : rval, cur_depth);
-    return rval;
+    return score;
+}
+
+// Searches depth 1, 2, ... max_depth (at most to the end of the game)
+// until `seconds` have passed, each iteration ordering the next through
+// the best moves it leaves in the cache.  An iteration cut short by the
+// deadline is dropped; depth 1 always completes.  After each completed
+// depth, report(depth, score, best, nodes).  Returns the score of the
+// deepest completed search, for the player to move.  A move ordering, if
+// given, learns across the iterations (and the moves it is kept for).
+template<class State, class CachingPolicy, class Evaluation = FullEval<State>, class Report>
+typename State::score_type iterative_deepening(State s, CachingPolicy &cache, double seconds, int max_depth,
+                                               State *best, int *moves, Report report,
+                                               MoveOrdering<State> *ordering = 0, int aspiration = ASPIRATION)
+{
+    Deadline deadline(Deadline::after(seconds));
+    return deepen<State,CachingPolicy,Evaluation>(s, cache, deadline, 1, 1, max_depth, true,
+                                                  best, moves, report, ordering, aspiration);
+}
+
+// Lazy SMP: iterative_deepening() on this thread, with threads-1 helpers
+// running the same search at the same time and filling the shared cache,
+// which must be thread-safe (TTPolicy).  Helpers differ from the main
+// search and from each other: odd ones search the odd depths, even ones
+// the even depths, and every other pair orders moves by killers and
+// history of its own.  They stop when the main search ends.  Only the main
+// search reports and sets best; moves counts the nodes of all threads.
+template<class State, class CachingPolicy, class Evaluation = FullEval<State>, class Report>
+typename State::score_type lazy_smp(State s, CachingPolicy &cache, double seconds, int max_depth, int threads,
+                                    State *best, int *moves, Report report, int aspiration = ASPIRATION)
+{
+    const auto at = Deadline::after(seconds);
+    StopFlag stop;
+    std::vector<int> nodes(threads, 0); // of the helpers
+    std::vector<std::thread> helpers;
+    for (int i = 1; i < threads; ++i)
+        helpers.emplace_back([&, i] {
+            Deadline deadline(at, &stop);
+            MoveOrdering<State> ordering;
+            deepen<State,CachingPolicy,Evaluation>(s, cache, deadline, 2 - (i & 1), 2, max_depth, false,
+                                                   (State*)0, &nodes[i], [](int, auto, const State&, int) { },
+                                                   (i & 2) ? &ordering : 0, aspiration);
+        });
+    Deadline deadline(at);
+    const auto score = deepen<State,CachingPolicy,Evaluation>(s, cache, deadline, 1, 1, max_depth, true,
+                                                              best, moves, report, (MoveOrdering<State>*)0, aspiration);
+    stop.raised = true;
+    for (auto& t: helpers) t.join();
+    if (moves) for (int n: nodes) *moves += n;
+    return score;
 }
 
-template<class State, class CachingPolicy = NoPolicy<State> >
+template<class State, class CachingPolicy = NoPolicy<State>, class Evaluation = FullEval<State> >
 auto alpha_beta(  State s, typename State::score_type alpha, typename State::score_type beta,
                                         bool max, bool second_player, int max_depth, int cur_depth = 0, State *best = 0, int *moves = 0 )
 {
     CachingPolicy tmp;
-    return alpha_beta_cache( s, tmp, alpha, beta, max, second_player, max_depth, cur_depth, best, moves );
+    return alpha_beta_cache<State,CachingPolicy,Evaluation>( s, tmp, alpha, beta, max, second_player, max_depth, cur_depth, best, moves );
 }
 
 /*
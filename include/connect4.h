@@ -22,42 +22,71 @@
 #ifndef _CONNECT4_H_
 #define _CONNECT4_H_
 
+#include "geometry.hpp"
+#include "small_vector.hpp"
+
 #include <iosfwd>
 //#include"mcts.h"
 
 
-class State {
+template<int W, int H>
+class BasicState {
+public:
+    using board_type = typename Geometry<W,H>::board_type;
+
+private:
+    using G = Geometry<W,H>;
+
     union {
-        unsigned char column[8];
-        size_t rep;
+        unsigned char column[sizeof(board_type)];
+        board_type rep;
     };
     // column bits: 7654|3210
     //              000H.....
     // H = bit pos denoting column height
     // ... = 0 or 1 denoting column contents
-    // column[7] bits: 7654|3210
-    //                      PMMM
-    // MMM = 0..6 last column played, 7 = NONE
+    // column[W] bits: 7654|3210
+    //                    PMMMM
+    // MMMM = 0..W-1 last column played, 15 = NONE
     // P = last player played (0 or 1)
+    //
+    // bitboards: bit 8*col+row, i.e. rep without the height markers
+    // (assumes little-endian byte order)
 public:
     struct Hasher {
-        size_t operator()(State s) const;
+        size_t operator()(BasicState s) const;
     };
 
-    class iterator;
+    struct KeyHasher {
+        size_t operator()(board_type k) const { return G::hash(k); }
+    };
 
-    enum { MINUS_INFINITY = -(1<<30),
+    // legal moves (columns) of the player to move, in search order
+    using move_list = small_vector<int,W>;
+
+    enum { WIDTH = W,
+           HEIGHT = H,
+           MINUS_INFINITY = -(1<<30),
            PLUS_INFINITY = 1<<30,
-           MAX_DEPTH = 42 };
+           MAX_DEPTH = W*H,
+           WIN_SCORE = 1000,
+           // of operator(), bumped when scores change meaning (for stored
+           // tables); 2: wins by distance (win_value)
+           SCORE_VERSION = 2 };
 
     using score_type = double ;
     
-    State();
-
-    iterator children() const;
-    State make_move(int col, int who) const;
-    State random_move() const;
-    State symmetric() const;
+    BasicState();
+
+    move_list moves() const;
+    move_list sorted_moves() const;
+    BasicState make_move(int col, int who) const;
+    template<class Rng>
+    BasicState random_move(Rng& rng) const;
+    template<class Rng>
+    int playout(Rng& rng) const;
+    BasicState symmetric() const;
+    static int mirror_column(int col);
     
     int last_player() const;
     int next_player() const;
@@ -67,43 +96,75 @@ public:
     bool is_terminal() const;
     int winner_info() const;
     int winner() const;
+    bool last_move_wins() const;
+    bool has_four(int who) const;
+
+    board_type occupied() const;
+    board_type bitboard(int who) const;
+    board_type playable() const;
+    board_type winning_cells(int who) const;
+    board_type non_losing_moves() const;
+    static move_list filter_moves(const move_list& ml, board_type cells);
         
     // evaluates ALWAYS for player 0 -- should negate result manually
     score_type operator()() const;
+    // for the winner, a win plies moves from here: WIN_SCORE plus the cells
+    // still empty after it, so the sooner the better
+    score_type win_value(int plies) const;
+
+    // heuristic value carried along a line of play and updated per move
+    struct Eval { int value; };
+    Eval eval() const;
+    Eval eval_move(Eval e, int col) const; // e of make_move(col, next_player())
+    score_type operator()(Eval e) const;
     
     int column_height(int col) const;
     int last_column() const;
     
     static_assert( sizeof(size_t) == 8 );
+    board_type key() const;
     size_t hash_value() const;
+    board_type canonical_key() const;
+    bool is_mirrored_key() const;
     
-    State up() const;
+    BasicState up() const;
     int empty_space() const;
     int get(int row, int col) const;
     bool is_empty() const;
     bool is_full() const;
     
 private:
-    static constexpr size_t BOARD_MASK = 0x00FFFFFFFFFFFFFF;
+    static constexpr board_type BOARD_MASK = G::BOARD_MASK;
+    static constexpr board_type BOTTOM_ROW = G::BOTTOM_ROW;
+    static constexpr int NONE = 15;
 
     void drop(int col, int who);
     bool undrop();
 
     static char symbol(int k);
     
-    int is_line(int k, int start) const;
-    
-    int get_column(int col) const;
-    int is_column(int k,int start) const;
-    int is_diag_ur(int r, int c) const;
-    int is_diag_ul(int r, int c) const;
+    static board_type windows(board_type b, int shift);
+    static board_type completions(board_type b);
+    template<class Rng>
+    static board_type random_cell(board_type cells, Rng& rng);
+    static int first_in_row(board_type w);
 
-    int line_heuristic(int y1, int x1, int dy, int dx) const;
+    static int open_windows(board_type b0, board_type b1);
     int heuristic_value() const;
+    void check_eval(Eval e) const;
 
 };
 
-bool operator==(State a, State b);
-bool operator<(State a, State b);
+template<int W, int H>
+bool operator==(BasicState<W,H> a, BasicState<W,H> b);
+template<int W, int H>
+bool operator<(BasicState<W,H> a, BasicState<W,H> b);
+
+// the standard board
+using State = BasicState<7,6>;
+
+// AVX2 kernel for the open windows of 64-bit boards (connect4.cpp)
+extern const bool HAS_AVX2;
+int open_windows_avx2(uint64_t b0, uint64_t b1, const uint64_t* windows, int count);
 
 #endif
@@ -25,6 +25,7 @@
 #include "connect4.h"
 
 #include <algorithm>
+#include <utility>
 #include <strings.h>
 //#include"mcts.h"
 
@@ -38,139 +39,216 @@ inline int fls(int k) {
 }
 #endif
 
-inline size_t State::Hasher::operator()(State s) const
+template<int W, int H>
+inline size_t BasicState<W,H>::Hasher::operator()(BasicState s) const
 {
     return s.hash_value();
 }
 
-class State::iterator
-{
-    int i;
-    const State& ref;
-    int sh[7];
-public:
-    iterator(const State &s): i(0), ref(s) {
-        for (int i = 0; i < 7; ++i) sh[i] = i;
-//            std::random_shuffle(sh,sh+7); // randomize branches
-        for (int i = 0; i < 7; ++i) {
-            if (ref.column_height(sh[i]) == 6) continue;
-            State s = ref.make_move(sh[i], ref.next_player());
-            if (s.is_terminal()) {
-                std::swap(sh[0],sh[i]); // prioritize immediate threat
-                break;
-            }
+template<int W, int H>
+inline BasicState<W,H>::BasicState()
+{
+    rep = BOTTOM_ROW;
+    column[W] = (1 << 4) | NONE;
+}
+
+// immediate wins first, then from the centre outwards
+template<int W, int H>
+inline typename BasicState<W,H>::move_list BasicState<W,H>::moves() const
+{
+    const board_type play = playable();
+    const board_type win = play & winning_cells(next_player());
+    move_list ml;
+    if (win)
+        for (int col: G::CENTRE_OUT)
+            if (win & G::column_mask(col)) ml.push_back(col);
+    for (int col: G::CENTRE_OUT)
+        if ((play & ~win) & G::column_mask(col)) ml.push_back(col);
+    return ml;
+}
+
+// as moves(), but after the immediate wins by the number of threats
+// (empty cells that would complete four) the move leaves the mover,
+// centre first among equals
+template<int W, int H>
+inline typename BasicState<W,H>::move_list BasicState<W,H>::sorted_moves() const
+{
+    const board_type play = playable();
+    const board_type mine = bitboard(next_player());
+    const board_type win = play & completions(mine);
+    const board_type empty = G::CELL_MASK & ~occupied();
+    move_list ml;
+    if (win)
+        for (int col: G::CENTRE_OUT)
+            if (win & G::column_mask(col)) ml.push_back(col);
+    const size_t first = ml.size();
+    int threats[W];
+    for (int col: G::CENTRE_OUT) {
+        const board_type cell = play & ~win & G::column_mask(col);
+        if (!cell) continue;
+        const int n = popcount(completions(mine | cell) & empty & ~cell);
+        size_t i = ml.size();
+        ml.push_back(col);
+        for (; i > first && threats[i-1] < n; --i) {
+            ml[i] = ml[i-1];
+            threats[i] = threats[i-1];
         }
+        ml[i] = col;
+        threats[i] = n;
     }
+    return ml;
+}
 
-    bool hasNext() {
-        while (i < 7) {
-            if (ref.column_height(sh[i]) < 6) return true;
-            else ++i;
-        }
-        return false;
-    }
+template<int W, int H>
+inline BasicState<W,H> BasicState<W,H>::make_move(int col, int who) const
+{
+    BasicState ret(*this);
+    ret.drop(col,who);
+    return ret;
+}
 
-    State next() {
-        State s = ref.make_move(sh[i],ref.next_player());
-        ++i;
-        return s;
+// immediate win if any, otherwise uniform
+template<int W, int H>
+template<class Rng>
+inline BasicState<W,H> BasicState<W,H>::random_move(Rng& rng) const
+{
+    const board_type play = playable();
+    const board_type win = play & winning_cells(next_player());
+    return make_move(ctz(random_cell(win ? win : play, rng)) >> 3, next_player());
+}
+
+// random game to the end on bitboards, moves chosen as by random_move();
+// returns the winner as winner() does
+template<int W, int H>
+template<class Rng>
+inline int BasicState<W,H>::playout(Rng& rng) const
+{
+    const int w = winner();
+    if (w < 3) return w;
+    int who = next_player();
+    board_type occ = occupied();
+    board_type mine = bitboard(who);
+    board_type theirs = occ ^ mine;
+    while (true) {
+        const board_type play = (occ + BOTTOM_ROW) & G::CELL_MASK;
+        if (!play) return 2;
+        if (play & completions(mine)) return who;
+        const board_type cell = random_cell(play, rng);
+        mine |= cell;
+        occ |= cell;
+        std::swap(mine, theirs);
+        who = !who;
     }
-};
-    
-
-inline State::State()
-{
-    std::fill(column, column+7, 1);
-    column[7] = 0x0F;
 }
 
-inline State::iterator State::children() const
+template<int W, int H>
+template<class Rng>
+inline typename BasicState<W,H>::board_type BasicState<W,H>::random_cell(board_type cells, Rng& rng)
 {
-    return iterator(*this);
+    for (unsigned k = rng.below(popcount(cells)); k; --k) cells &= cells - 1;
+    return cells & (~cells + 1);
 }
 
-inline State State::make_move(int col, int who) const
+template<int W, int H>
+inline BasicState<W,H> BasicState<W,H>::symmetric() const
 {
-    State ret(*this);
-    ret.drop(col,who);
+    BasicState ret;
+    ret.rep = bswap(rep) >> G::MIRROR_SHIFT; // columns W-1..0, byte W cleared
+    const int col = last_column();
+    ret.column[W] = (column[W] & 0x10) | (col < W ? mirror_column(col) : col);
     return ret;
 }
 
-inline State State::random_move() const
+template<int W, int H>
+inline int BasicState<W,H>::mirror_column(int col)
 {
-    char ci[7];
-    int nc = 0;
-    for (int i = 0; i < 7; ++i)
-        if (column_height(i) < 6) ci[nc++] = i;
-    for (int i = 0; i < nc; ++i) {
-        State s = make_move(i, next_player());
-        if (s.is_terminal()) return s; // immediate threat!
-    }
-    return make_move(ci[rand() % nc], next_player());
-}
-
-inline State State::symmetric() const
-{
-    // TODO: possibly speedup with bit magic...
-//        State ret(*this); // "saves" column[3]?
-    State ret;
-    ret.column[0] = column[6];
-    ret.column[1] = column[5];
-    ret.column[2] = column[4];
-    ret.column[3] = column[3];
-    ret.column[4] = column[2];
-    ret.column[5] = column[1];
-    ret.column[6] = column[0];
-    ret.column[7] = (last_player() << 3) | (6 - last_column());
-    return ret;
+    return W-1 - col;
 }
 
-inline int State::last_player() const
+template<int W, int H>
+inline int BasicState<W,H>::last_player() const
 {
-    return column[7] >> 3;
+    return column[W] >> 4;
 }
 
-inline int State::next_player() const
+template<int W, int H>
+inline int BasicState<W,H>::next_player() const
 {
     return !last_player();
 }
 
-inline bool State::is_terminal() const
+template<int W, int H>
+inline bool BasicState<W,H>::is_terminal() const
 {
     return winner() < 3;
 }
 
-// bits: DDCCCRRRWW
+// bits: DDCCCRRRWW (DDCCCCRRRWW if W > 8)
 // W: 3 = non-final state, 0 = X, 1 = O, 2 = draw
 // R: row
 // C: column
 // D: direction 0 = line LtRt, 1 = column DnUp, 2 = diag UR, 3 = diag UL
-inline int State::winner_info() const
-{
-    int k;
-
-    for (int i = 0; i < 6; ++i) for (int j = 0; j < 4; ++j)
-        if ((k = is_line(i,j)) >= 0) return (j<<5) | (i<<2) | k;
-
-    for (int j = 0; j < 7; ++j) for (int i = 0; i < column_height(j)-3; ++i)
-        if ((k = is_column(j,i)) >= 0) return 0x100 | (j<<5) | (i<<2) | k;
-
-    for (int i = 0; i < 3; ++i) for (int j = 0; j < 4; ++j)
-        if ((k = is_diag_ur(i,j)) >= 0) return 0x200 | (j<<5) | (i<<2) | k;
+template<int W, int H>
+inline int BasicState<W,H>::winner_info() const
+{
+    // bit distance between neighbouring cells for each direction D
+    static constexpr int SHIFT[4] = { 8, 1, 9, 7 };
+    static constexpr int DIR_POS = W > 8 ? 9 : 8;
+    const board_type b1 = bitboard(1);
+    const board_type b0 = occupied() ^ b1;
+
+    for (int d = 0; d < 4; ++d) {
+        board_type w = windows(b0, SHIFT[d]) | windows(b1, SHIFT[d]);
+        if (!w) continue;
+        if (d == 3) w <<= 3*SHIFT[3]; // diag UL starts at its lowest cell
+        // same scan order as the cell-by-cell version: DnUp is column-major
+        const int k = d == 1 ? ctz(w) : first_in_row(w);
+        return (d << DIR_POS) | ((k >> 3) << 5) | ((k & 7) << 2) | int((b1 >> k) & 1);
+    }
 
-    for (int i = 0; i < 3; ++i) for (int j = 3; j < 7; ++j)
-        if ((k = is_diag_ul(i,j)) >= 0) return 0x300 | (j<<5) | (i<<2) | k;
+    if (is_full()) return 2;
+    return 3;
+}
 
+// same as winner_info() & 3, without locating the line
+template<int W, int H>
+inline int BasicState<W,H>::winner() const
+{
+    if (last_column() < W) {
+        if (last_move_wins()) return last_player();
+    } else { // no last move to go by (initial state, up())
+        if (has_four(0)) return 0;
+        if (has_four(1)) return 1;
+    }
     if (is_full()) return 2;
     return 3;
 }
 
-inline int State::winner() const
-{ return winner_info() & 3;
+// only lines through the last disc dropped
+template<int W, int H>
+inline bool BasicState<W,H>::last_move_wins() const
+{
+    const int col = last_column();
+    if (col >= W) return false;
+    const board_type p = board_type(1) << ((col << 3) + column_height(col) - 1);
+    const board_type b = bitboard(last_player());
+    // windows are named after their first cell, which is p or below it
+    return (windows(b, 8) & (p | p >> 8 | p >> 16 | p >> 24)) |
+           (windows(b, 1) & (p >> 3)) | // p can only be on top
+           (windows(b, 9) & (p | p >> 9 | p >> 18 | p >> 27)) |
+           (windows(b, 7) & (p | p >> 7 | p >> 14 | p >> 21));
+}
+
+template<int W, int H>
+inline bool BasicState<W,H>::has_four(int who) const
+{
+    const board_type b = bitboard(who);
+    return windows(b, 8) | windows(b, 1) | windows(b, 9) | windows(b, 7);
 }
 
 // evaluates ALWAYS for player 0 -- should negate result manually
-inline State::score_type State::operator()() const
+template<int W, int H>
+inline typename BasicState<W,H>::score_type BasicState<W,H>::operator()() const
 {
     int w = winner();
     if (w == 3){
@@ -179,163 +257,284 @@ inline State::score_type State::operator()() const
     }
     if (w == 2) return 0;
 //        if (w == -1) return (9.0-(last_column()-3)*(last_column()-3))/3.0;
-    if (w == 0) return 1000; else return -1000;
+    if (w == 0) return win_value(0); else return -win_value(0);
+}
+
+template<int W, int H>
+inline typename BasicState<W,H>::score_type BasicState<W,H>::win_value(int plies) const
+{
+    return WIN_SCORE + empty_space() - plies;
+}
+
+template<int W, int H>
+inline typename BasicState<W,H>::Eval BasicState<W,H>::eval() const
+{
+    return {heuristic_value()};
+}
+
+// only the windows through the new disc change
+template<int W, int H>
+inline typename BasicState<W,H>::Eval BasicState<W,H>::eval_move(Eval e, int col) const
+{
+    const int who = next_player();
+    const int row = column_height(col);
+    const int k = (col << 3) + row;
+    const board_type mine = bitboard(who);
+    const board_type theirs = occupied() ^ mine;
+    const auto& cw = CELL_WINDOWS<W,H>[k];
+    int d = 0;
+    for (int i = 0; i < cw.count; ++i)
+        d += WINDOW_GAIN.gain[popcount(mine & cw.mask[i])][popcount(theirs & cw.mask[i])];
+    if (row >= 3 && ((mine >> (k-3)) & 7) == 7) d += WINDOW_WEIGHT[4]; // vertical four
+    Eval r{e.value + (who ? -d : d)};
+#ifdef CHECK_EVAL
+    make_move(col, who).check_eval(r);
+#endif
+    return r;
+}
+
+// as operator()(), with the heuristic value taken from e
+template<int W, int H>
+inline typename BasicState<W,H>::score_type BasicState<W,H>::operator()(Eval e) const
+{
+    int w = winner();
+    if (w == 3) return e.value;
+    if (w == 2) return 0;
+    if (w == 0) return win_value(0); else return -win_value(0);
 }
 
-inline int State::column_height(int col) const
+template<int W, int H>
+inline int BasicState<W,H>::column_height(int col) const
 {
     return fls(column[col])-1;
 }
 
-inline int State::last_column() const
+template<int W, int H>
+inline int BasicState<W,H>::last_column() const
 {
-    return column[7] & 0x07;
+    return column[W] & 0x0F;
 }
 
-inline bool operator==(State a, State b)
+template<int W, int H>
+inline bool operator==(BasicState<W,H> a, BasicState<W,H> b)
 {
-    return a.hash_value() == b.hash_value(); // perfect hash
+    return a.key() == b.key();
 }
 
-inline bool operator<(State a, State b)
+template<int W, int H>
+inline bool operator<(BasicState<W,H> a, BasicState<W,H> b)
 {
-    return a.hash_value() < b.hash_value();
+    return a.key() < b.key();
 }
 
-inline size_t State::hash_value() const
+// the board without the last move
+template<int W, int H>
+inline typename BasicState<W,H>::board_type BasicState<W,H>::key() const
 {
-    return rep & BOARD_MASK; // perfect hash
+    return rep & BOARD_MASK;
 }
 
-inline State State::up() const
+template<int W, int H>
+inline size_t BasicState<W,H>::hash_value() const
 {
-    State s = *this;
+    return G::hash(key());
+}
+
+// the smaller of the board and its mirror image: one key for both,
+// so position tables need a single probe and store
+template<int W, int H>
+inline typename BasicState<W,H>::board_type BasicState<W,H>::canonical_key() const
+{
+    return std::min(key(), bswap(rep) >> G::MIRROR_SHIFT);
+}
+
+// columns stored under canonical_key() need mirror_column() if true
+template<int W, int H>
+inline bool BasicState<W,H>::is_mirrored_key() const
+{
+    return (bswap(rep) >> G::MIRROR_SHIFT) < key();
+}
+
+template<int W, int H>
+inline BasicState<W,H> BasicState<W,H>::up() const
+{
+    BasicState s = *this;
     s.undrop();
     return s;
 }
 
-inline int State::empty_space() const
+template<int W, int H>
+inline int BasicState<W,H>::empty_space() const
 {
-    return 42 - column_height(0) - column_height(1) - column_height(2) -
-    column_height(3) - column_height(4) - column_height(5) -
-    column_height(6);
+    return G::CELLS - popcount(occupied());
 }
 
-inline int State::get(int row, int col) const
+template<int W, int H>
+inline int BasicState<W,H>::get(int row, int col) const
 {
     if (row >= column_height(col)) return -1;
     return (column[col] & (1 << row)) > 0;
 }
 
-inline bool State::is_empty() const
+template<int W, int H>
+inline bool BasicState<W,H>::is_empty() const
+{
+    return (rep & BOARD_MASK) == BOTTOM_ROW; // all height markers at row 0
+}
+
+template<int W, int H>
+inline bool BasicState<W,H>::is_full() const
+{
+    return (rep & (BOTTOM_ROW << H)) == (BOTTOM_ROW << H); // ... at row H
+}
+
+// cells below the height markers
+template<int W, int H>
+inline typename BasicState<W,H>::board_type BasicState<W,H>::occupied() const
 {
-    return column_height(0) == 0 && column_height(1) == 0 &&
-            column_height(2) == 0 && column_height(3) == 0 &&
-            column_height(4) == 0 && column_height(5) == 0 &&
-            column_height(6) == 0;
+    board_type x = rep & BOARD_MASK;
+    // smear each marker down to bit 0 of its byte
+    x |= (x >> 1) & G::bytes(0x7F);
+    x |= (x >> 2) & G::bytes(0x3F);
+    x |= (x >> 4) & G::bytes(0x0F);
+    return (x >> 1) & G::bytes(0x7F);
 }
 
-inline bool State::is_full() const
+template<int W, int H>
+inline typename BasicState<W,H>::board_type BasicState<W,H>::bitboard(int who) const
 {
-    return column_height(0) == 6 && column_height(1) == 6 &&
-            column_height(2) == 6 && column_height(3) == 6 &&
-            column_height(4) == 6 && column_height(5) == 6 &&
-            column_height(6) == 6;
+    const board_type occ = occupied();
+    return who ? rep & occ : ~rep & occ;
 }
     
-inline void State::drop(int col, int who)
+// the cell above each column that is not full
+template<int W, int H>
+inline typename BasicState<W,H>::board_type BasicState<W,H>::playable() const
+{
+    return (occupied() + BOTTOM_ROW) & G::CELL_MASK;
+}
+
+// cells (empty or not) that would complete four in a row for who
+template<int W, int H>
+inline typename BasicState<W,H>::board_type BasicState<W,H>::winning_cells(int who) const
+{
+    return completions(bitboard(who));
+}
+
+// Playable cells after which the opponent cannot win at once: only the
+// block of a single immediate win of theirs, none against two, and never
+// the cell under one of their winning cells.  0 means the player to move
+// loses in two plies, unless they have an immediate win themselves.
+template<int W, int H>
+inline typename BasicState<W,H>::board_type BasicState<W,H>::non_losing_moves() const
+{
+    const board_type play = playable();
+    const board_type threats = winning_cells(last_player()) & ~occupied();
+    board_type safe = play;
+    if (const board_type forced = play & threats) {
+        if (forced & (forced-1)) return 0;
+        safe = forced;
+    }
+    return safe & ~(threats >> 1);
+}
+
+// the moves of ml that play in a column with a cell in cells, same order
+template<int W, int H>
+inline typename BasicState<W,H>::move_list BasicState<W,H>::filter_moves(const move_list& ml, board_type cells)
+{
+    move_list r;
+    for (int col: ml)
+        if (cells & G::column_mask(col)) r.push_back(col);
+    return r;
+}
+
+// row 7 is always empty, so no line can continue across two columns
+template<int W, int H>
+inline typename BasicState<W,H>::board_type BasicState<W,H>::completions(board_type b)
+{
+    board_type r = (b << 1) & (b << 2) & (b << 3); // on top of three
+    for (int shift: {8, 9, 7}) {
+        board_type p = (b << shift) & (b << 2*shift);
+        r |= p & (b << 3*shift);
+        r |= p & (b >> shift);
+        p = (b >> shift) & (b >> 2*shift);
+        r |= p & (b << shift);
+        r |= p & (b >> 3*shift);
+    }
+    return r & G::CELL_MASK;
+}
+
+template<int W, int H>
+inline void BasicState<W,H>::drop(int col, int who)
 {
     const int h = column_height(col);
-    if (h >= 6) return;
+    if (h >= H) return;
     column[col] &= (1 << h) - 1;
     column[col] |= (2+who) << h;
-    column[7] = (who << 3) | col;
+    column[W] = (who << 4) | col;
 }
 
-inline bool State::undrop()
+template<int W, int H>
+inline bool BasicState<W,H>::undrop()
 {
     const int col = last_column();
-    if (col > 6) return false;
+    if (col >= W) return false;
     int h = column_height(col);
     if (h == 0) return false;
     --h;
     column[col] &= (1 << h) - 1;
     column[col] |= 1 << h;
     const int who = last_player();
-    column[7] = ((!who) << 3) | 7;
+    column[W] = ((!who) << 4) | NONE;
     return true;
 }
 
-inline char State::symbol(int k)
+template<int W, int H>
+inline char BasicState<W,H>::symbol(int k)
 {
     if (k == 0) return 'X';
     if (k == 1) return 'O';
     return '.';
 }
 
-// -1 = no line, 0 = X, 1 = O
-inline int State::is_line(int k, int start) const
+// first cells of all four-in-a-row windows of b along direction `shift`;
+// row 7 is always empty so windows cannot wrap around columns
+template<int W, int H>
+inline typename BasicState<W,H>::board_type BasicState<W,H>::windows(board_type b, int shift)
 {
-    if (get(k,start) == get(k,start+1) && get(k,start+1) == get(k,start+2) &&
-        get(k,start+2) == get(k,start+3)) return get(k,start);
-    else return -1;
+    b &= b >> shift;
+    return b & (b >> 2*shift);
 }
 
-inline int State::get_column(int col) const
+// lowest set bit of w in row-major order
+template<int W, int H>
+inline int BasicState<W,H>::first_in_row(board_type w)
 {
-    return column[col] & ((1 << column_height(col)) - 1);
-}
-
-inline int State::is_column(int k,int start) const
-{
-    if (start+4 > column_height(k)) return -1;
-    int c = get_column(k);
-    c = (c >> start) & 0x0F;
-    if (c == 0) return 0;
-    if (c == 0x0F) return 1;
-    return -1;
-}
-
-inline int State::is_diag_ur(int r, int c) const
-{
-    if (get(r,c) == get(r+1,c+1) && get(r+1,c+1) == get(r+2,c+2) &&
-        get(r+2,c+2) == get(r+3,c+3)) return get(r,c);
-    else return -1;
-}
-
-inline int State::is_diag_ul(int r, int c) const
-{
-    if (get(r,c) == get(r+1,c-1) && get(r+1,c-1) == get(r+2,c-2) &&
-        get(r+2,c-2) == get(r+3,c-3)) return get(r,c);
-    else return -1;
+    board_type row = BOTTOM_ROW;
+    while (!(w & row)) row <<= 1;
+    return ctz(w & row);
 }
 
 // evaluates for player 0 -- negate manually
-inline int State::line_heuristic(int y1, int x1, int dy, int dx) const
+template<int W, int H>
+inline int BasicState<W,H>::heuristic_value() const
 {
-    int n[2] = {0};
-    for (int i = 0; i < 4; ++i) {
-        int k = get(y1, x1);
-        if (k >= 0) ++n[k];
-        x1 += dx; y1 += dy;
-    }
-    if (n[0] > 0 && n[1] > 0) return 0;
-    const static int ans[5] = {0, 0x04, 0x10, 0x40, 0xFF};
-    return ans[n[0]] - ans[n[1]];
+    const board_type b1 = bitboard(1);
+    const board_type b0 = occupied() ^ b1;
+    // vertical windows count only when complete, i.e. four in a row
+    const int vert = popcount(windows(b0, 1)) - popcount(windows(b1, 1));
+    if constexpr (std::is_same_v<board_type,uint64_t>)
+        if (HAS_AVX2) return WINDOW_WEIGHT[4]*vert +
+            open_windows_avx2(b0, b1, WINDOWS<W,H>.data(), G::NUM_OPEN_WINDOWS);
+    return WINDOW_WEIGHT[4]*vert + open_windows(b0, b1);
 }
 
-// evaluates for player 0 -- negate manually
-inline int State::heuristic_value() const
+template<int W, int H>
+inline int BasicState<W,H>::open_windows(board_type b0, board_type b1)
 {
     int val = 0;
-    for (int i = 0; i < 6; ++i) for (int j = 0; j < 4; ++j) // horiz
-        val += line_heuristic(i,j,0,1);
-    for (int j = 0; j < 7; ++j) for (int i = 0; i < column_height(j)-3; ++i) // vert
-        val += line_heuristic(i,j,1,0);
-    for (int i = 0; i < 3; ++i) for (int j = 0; j < 4; ++j) // diag UR
-        val += line_heuristic(i,j,1,1);
-    for (int i = 0; i < 3; ++i) for (int j = 3; j < 7; ++j) // diag UL
-        val += line_heuristic(i,j,1,-1);
+    for (int i = 0; i < G::NUM_OPEN_WINDOWS; ++i)
+        val += window_score(popcount(b0 & WINDOWS<W,H>[i]), popcount(b1 & WINDOWS<W,H>[i]));
     return val;
 }
                       
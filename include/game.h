@@ -29,6 +29,7 @@
 
 class ViewBase;
 class AudioBase;
+template<class State> struct TTPolicy;
 
 class Game
 {
@@ -36,10 +37,16 @@ public:
     int think_algo; // 0..3, bit 1: player X, bit 0: 0=AB 1=MC
 
     Game(ViewBase& _view, AudioBase& _audio);
+    ~Game();
 
     bool is_demo(int p) const { return _demo[p]; }
     State state() const;
     const std::string& get_msg() const { return _msg; }
+    void set_think_time(double seconds) { _think_time = seconds; }
+    void set_threads(int n) { _threads = n > 0 ? n : 1; }
+    void set_hash_size(int megabytes);
+    void set_snapshot(const std::string& path) { _snapshot = path; }
+    bool save_snapshot() const;
 
     void acRestart();
     bool acPlay(int where = 0);
@@ -60,11 +67,15 @@ private:
 
     int         _move;
     int         _max_move;
-    State       _history[42];
+    State       _history[State::MAX_DEPTH];
     bool        _demo[2];
     ViewBase&   _view;
     AudioBase&  _audio;
-    int         _depth;
+    double      _think_time; // seconds per alpha-beta move
+    int         _threads; // alpha-beta search threads (Lazy SMP)
+    size_t      _hash_bytes; // alpha-beta table memory
+    std::unique_ptr<TTPolicy<State>> _cache; // alpha-beta table, for the whole session
+    std::string _snapshot; // file the table starts from, if any
     std::string _msg; // algorithm stats
 };
 
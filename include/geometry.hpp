@@ -0,0 +1,159 @@
+/*
+    Connect Four 2014 (c) 2014 George M. Tzoumas
+
+    This file is part of Connect Four 2014.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// compile-time board geometry (engine)
+
+#ifndef _GEOMETRY_HPP_
+#define _GEOMETRY_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+using uint128_t = unsigned __int128;
+
+inline int popcount(uint64_t x) { return __builtin_popcountll(x); }
+inline int popcount(uint128_t x) { return popcount(uint64_t(x)) + popcount(uint64_t(x >> 64)); }
+
+inline int ctz(uint64_t x) { return __builtin_ctzll(x); }
+inline int ctz(uint128_t x) { return uint64_t(x) ? ctz(uint64_t(x)) : 64 + ctz(uint64_t(x >> 64)); }
+
+inline uint64_t bswap(uint64_t x) { return __builtin_bswap64(x); }
+inline uint128_t bswap(uint128_t x) { return (uint128_t(bswap(uint64_t(x))) << 64) | bswap(uint64_t(x >> 64)); }
+
+// W columns of H rows: one byte per column (bit 8*col+row) and one more
+// for the last move, in the smallest unsigned integer that holds them
+template<int W, int H>
+struct Geometry
+{
+    static_assert(4 <= W && W <= 15, "column index must fit in 4 bits");
+    static_assert(4 <= H && H <= 7, "column and height marker must fit in a byte");
+
+    using board_type = std::conditional_t<(W+1 <= 8), uint64_t, uint128_t>;
+
+    static constexpr int CELLS = W*H;
+
+    static constexpr board_type bytes(unsigned char b)
+    {
+        board_type r = 0;
+        for (size_t i = 0; i < sizeof(board_type); ++i) r = (r << 8) | b;
+        return r;
+    }
+
+    static constexpr board_type BOARD_MASK = (board_type(1) << 8*W) - 1;
+    static constexpr board_type BOTTOM_ROW = bytes(0x01) & BOARD_MASK;
+    static constexpr board_type CELL_MASK = bytes((1 << H) - 1) & BOARD_MASK;
+
+    static constexpr board_type column_mask(int col) { return board_type(0xFF) << 8*col; }
+
+    // columns from the centre outwards, left first
+    static constexpr std::array<int,W> CENTRE_OUT = [] {
+        std::array<int,W> order{};
+        int n = 0;
+        for (int d = 0; d < W; ++d) // twice the distance from the centre
+            for (int c = 0; c < W; ++c)
+                if (2*c - (W-1) == d || (W-1) - 2*c == d) order[n++] = c;
+        return order;
+    }();
+
+    // byte swap leaves the columns at the top, reversed
+    static constexpr int MIRROR_SHIFT = 8*(sizeof(board_type) - W);
+
+    // horizontal, diag UR, diag UL ("open": scored while incomplete), vertical
+    static constexpr int NUM_OPEN_WINDOWS = H*(W-3) + 2*(H-3)*(W-3);
+    static constexpr int NUM_WINDOWS = NUM_OPEN_WINDOWS + W*(H-3);
+
+    static size_t hash(board_type k)
+    {
+        if constexpr (sizeof(board_type) == sizeof(size_t)) return k; // perfect hash
+        else return size_t(k) ^ size_t(k >> 64) * 0x9E3779B97F4A7C15;
+    }
+};
+
+// all four-cell windows as bitboards, open ones first
+template<int W, int H>
+constexpr auto make_windows()
+{
+    using G = Geometry<W,H>;
+    using board_type = typename G::board_type;
+    std::array<board_type,G::NUM_WINDOWS> w{};
+    int n = 0;
+    auto line = [](int r, int c, int dr, int dc) {
+        board_type m = 0;
+        for (int i = 0; i < 4; ++i) m |= board_type(1) << (((c+i*dc) << 3) + r+i*dr);
+        return m;
+    };
+    for (int i = 0; i < H; ++i) for (int j = 0; j < W-3; ++j) w[n++] = line(i,j,0,1);
+    for (int i = 0; i < H-3; ++i) for (int j = 0; j < W-3; ++j) w[n++] = line(i,j,1,1);
+    for (int i = 0; i < H-3; ++i) for (int j = 3; j < W; ++j) w[n++] = line(i,j,1,-1);
+    for (int j = 0; j < W; ++j) for (int i = 0; i < H-3; ++i) w[n++] = line(i,j,1,0);
+    return w;
+}
+
+template<int W, int H>
+alignas(32) inline constexpr auto WINDOWS = make_windows<W,H>();
+
+// window value for player 0 by number of discs of each player in it
+constexpr int WINDOW_WEIGHT[5] = {0, 0x04, 0x10, 0x40, 0xFF};
+
+constexpr int window_score(int n0, int n1)
+{
+    return (n0 > 0 && n1 > 0) ? 0 : WINDOW_WEIGHT[n0] - WINDOW_WEIGHT[n1];
+}
+
+// value change of a window when player 0 adds a disc to it (the
+// negation for player 1), by discs of the mover and the opponent
+struct WindowGain { int gain[4][4]; };
+
+constexpr WindowGain make_window_gain()
+{
+    WindowGain g{};
+    for (int n = 0; n < 4; ++n) for (int o = 0; o < 4; ++o)
+        g.gain[n][o] = n+o < 4 ? window_score(n+1, o) - window_score(n, o) : 0;
+    return g;
+}
+
+inline constexpr WindowGain WINDOW_GAIN = make_window_gain();
+
+// open windows through a cell: at most 4 per direction
+template<class Board>
+struct CellWindows
+{
+    int count;
+    Board mask[12];
+};
+
+// by bit position
+template<int W, int H>
+constexpr auto make_cell_windows()
+{
+    using G = Geometry<W,H>;
+    using board_type = typename G::board_type;
+    std::array<CellWindows<board_type>,8*W> cw{};
+    for (int i = 0; i < G::NUM_OPEN_WINDOWS; ++i)
+        for (int k = 0; k < 8*W; ++k)
+            if (WINDOWS<W,H>[i] & (board_type(1) << k)) cw[k].mask[cw[k].count++] = WINDOWS<W,H>[i];
+    return cw;
+}
+
+template<int W, int H>
+inline constexpr auto CELL_WINDOWS = make_cell_windows<W,H>();
+
+#endif
@@ -0,0 +1,115 @@
+/*
+    Connect Four 2014 (c) 2014 George M. Tzoumas
+
+    This file is part of Connect Four 2014.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// large zeroed allocations on huge pages where the system has them (engine)
+
+#ifndef _LARGEPAGES_HPP_
+#define _LARGEPAGES_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <sys/mman.h>
+
+// what large_alloc() got
+enum PageKind { SMALL_PAGES, TRANSPARENT_HUGE_PAGES, HUGE_PAGES };
+
+inline const char* page_kind_name(PageKind k)
+{
+    switch (k) {
+        case HUGE_PAGES: return "2 MB pages";
+        case TRANSPARENT_HUGE_PAGES: return "transparent huge pages";
+        default: return "small pages";
+    }
+}
+
+constexpr size_t HUGE_PAGE_BYTES = size_t(2) << 20;
+
+// Anonymous zeroed memory of bytes, rounded up to the mapping (free with
+// large_free() of the rounded bytes); null if there is none.  From 2 MB up
+// and with huge, explicit 2 MB pages (Linux hugetlbfs) if enough are
+// reserved, else memory aligned to 2 MB and advised for transparent huge
+// pages, else (or elsewhere) small pages.  kind tells which; the kernel
+// may still back advised memory with small pages (huge_page_bytes()).
+inline void* large_alloc(size_t& bytes, bool huge, PageKind* kind)
+{
+    const size_t page = 4096;
+    bytes = (bytes + page-1) & ~(page-1);
+    *kind = SMALL_PAGES;
+    if (!huge || bytes < HUGE_PAGE_BYTES)
+    {
+        void* p = ::mmap(0, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return p == MAP_FAILED ? 0 : p;
+    }
+    const size_t rounded = (bytes + HUGE_PAGE_BYTES-1) & ~(HUGE_PAGE_BYTES-1);
+#ifdef MAP_HUGETLB
+    void* p = ::mmap(0, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (p != MAP_FAILED) {
+        bytes = rounded;
+        *kind = HUGE_PAGES;
+        return p;
+    }
+#endif
+    // 2 MB more than needed, trimmed to the aligned part
+    char* q = static_cast<char*>(::mmap(0, rounded + HUGE_PAGE_BYTES, PROT_READ | PROT_WRITE,
+                                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    if (q == MAP_FAILED) return 0;
+    char* a = reinterpret_cast<char*>((uintptr_t(q) + HUGE_PAGE_BYTES-1) & ~uintptr_t(HUGE_PAGE_BYTES-1));
+    if (a > q) ::munmap(q, a-q);
+    if (a + rounded < q + rounded + HUGE_PAGE_BYTES) ::munmap(a + rounded, q + HUGE_PAGE_BYTES - a);
+    bytes = rounded;
+#ifdef MADV_HUGEPAGE
+    if (::madvise(a, rounded, MADV_HUGEPAGE) == 0) *kind = TRANSPARENT_HUGE_PAGES;
+#endif
+    return a;
+}
+
+inline void large_free(void* p, size_t bytes)
+{
+    if (p) ::munmap(p, bytes);
+}
+
+// bytes of the mapping at p backed by transparent huge pages so far (as
+// /proc/self/smaps tells, 0 where there is none)
+inline size_t huge_page_bytes(const void* p)
+{
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    bool inside = false;
+    while (std::getline(smaps, line)) {
+        uintptr_t lo, hi;
+        char dash;
+        std::istringstream ss(line);
+        if (line.find(':') == std::string::npos || line.find(':') > line.find(' ')) {
+            // a mapping: lo-hi perms ...
+            if (ss >> std::hex >> lo >> dash >> hi && dash == '-')
+                inside = lo <= uintptr_t(p) && uintptr_t(p) < hi;
+        } else if (inside && line.compare(0, 14, "AnonHugePages:") == 0) {
+            size_t kb = 0;
+            std::istringstream(line.substr(14)) >> kb;
+            return kb << 10;
+        }
+    }
+    return 0;
+}
+
+#endif // _LARGEPAGES_HPP_
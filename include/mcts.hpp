@@ -27,57 +27,12 @@
 #include<unordered_map>
 #include<cmath>
 #include<tuple>
+#include<utility>
 
-template<class T,size_t N>
-class small_vector
-{
-    using Rep = std::array<T,N>;
-
-    size_t _size;
-    Rep _rep;
-public:
-    using value_type = T;
-    using pointer    = T*;
-
-    small_vector(): _size(0) {}
-
-    template<class U>
-    void push_back(U&& x)
-    {
-        _rep[_size++] = std::forward<U>(x);
-    }
-
-    void push_back() { _rep[_size++] = T(); }
-
-    small_vector(const small_vector&) = default;
-
-    small_vector(small_vector&& v):
-        _rep(std::move(v._rep)),
-        _size(std::exchange(v._size,0))
-    {}
-
-    small_vector& operator=(const small_vector&) = default;
-    small_vector& operator=(small_vector&& v)
-    {
-        _rep = std::move(v._rep);
-        _size = std::exchange(v._size, 0);
-    }
-
-    const T& operator[](size_t i) const { return _rep[i]; }
-    T& operator[](size_t i) { return _rep[i]; }
-
-    auto begin() const { return _rep.begin(); }
-    auto end() const { return _rep.begin() + _size; }
-
-    const T& front() const  { return _rep.front(); }
-    T& front()              { return _rep.front(); }
-
-    const T& back() const  { return _rep[_size-1]; }
-    T& back()              { return _rep[_size-1]; }
-
-    size_t size() const { return _size; }
-    bool   empty() const { return _size == 0; }
-};
+#include "geometry.hpp"
+#include "playout.h"
+#include "small_vector.hpp"
+#include "xoshiro.hpp"
 
 inline void hash_combine(size_t & seed, const size_t& hv)
 {
@@ -195,7 +150,6 @@ StateDepth<State> select( const Tree<State,MAXD>& tree )
 
     while (true)
     {
-        auto it = sel.state.children();
         ++sel.depth;
         if (sel.depth == tree.levels.size())
         {
@@ -203,9 +157,9 @@ StateDepth<State> select( const Tree<State,MAXD>& tree )
         }
         auto& nextLevel = tree.levels[sel.depth];
         small_vector<Info,BF> next;
-        while (it.hasNext())
+        for (int col: sel.state.moves())
         {
-            auto tmp = it.next();
+            auto tmp = sel.state.make_move(col, sel.state.next_player());
             auto found = nextLevel.find({tmp,sel.depth});
             if (found != nextLevel.end())
             {
@@ -227,32 +181,43 @@ StateDepth<State> select( const Tree<State,MAXD>& tree )
 
 // 2) EXPAND
 
+// the moves worth a child: those of State::non_losing_moves(), unless the
+// player to move can win at once or has nothing but losing moves
+template<class State>
+typename State::move_list expansion_moves(const State& s)
+{
+    auto ml = s.moves();
+    if (s.playable() & s.winning_cells(s.next_player())) return ml;
+    const auto safe = s.non_losing_moves();
+    return safe ? State::filter_moves(ml, safe) : ml;
+}
+
 template<size_t MAXD,class State>
 State expand( Tree<State,MAXD>& tree, const StateDepth<State>& aSel )
 {
     if (!aSel.state.is_terminal())
     {
-        auto it = aSel.state.children();
+        auto ml = expansion_moves(aSel.state);
 //        auto nextLevel = aSel.depth; // assert == level ?
         tree.levels.push_back();
-        if (!it.hasNext())
+        if (ml.empty())
         {
             return aSel.state;
         }
         State last;
-        do
+        for (int col: ml)
         {
-            last = it.next();
+            last = aSel.state.make_move(col, aSel.state.next_player());
             tree.levels.back()[StateDepth<State>{last,aSel.depth}] = NodeData();
-        } while (it.hasNext());
+        }
         return last;
     }
     return aSel.state;
 }
 
 // 3) SIMULATE
-template<class State>
-NodeData simulate(const State& s, int num_samples)
+template<class State,class Rng>
+NodeData simulate(const State& s, int num_samples, Rng& rng)
 {
     int w = s.winner();
     if (w == 2) return {0,0,1};
@@ -262,31 +227,57 @@ NodeData simulate(const State& s, int num_samples)
     int nw[3] = {0};
     for (int i = 0; i < num_samples; ++i)
     {
-        State r = s;
-        while (!r.is_terminal())
-        {
-            r = r.random_move();
-            //            r.dump(std::cerr);
-        }
-        ++nw[r.winner()];
+        ++nw[s.playout(rng)];
         //        std::cerr << i << std::endl;
     }
     return {nw[0],nw[1],num_samples};
 }
 
+template<class State>
+NodeData simulate(const State& s, int num_samples)
+{
+    return simulate(s, num_samples, playout_rng());
+}
+
+// the same, num_samples games in SIMD lanes (playout.h) when the board
+// fits in 64 bits; otherwise simulate()
+template<class State,class Rng>
+NodeData simulate_batch(const State& s, int num_samples, Rng& rng)
+{
+    if constexpr (sizeof(typename State::board_type) == sizeof(uint64_t))
+    {
+        int w = s.winner();
+        if (w == 2) return {0,0,1};
+        if (w == 0) return {1,0,1};
+        if (w == 1) return {0,1,1};
+
+        int nw[2] = {0};
+        batch_playouts(s.bitboard(s.next_player()), s.occupied(),
+                       Geometry<State::WIDTH,State::HEIGHT>::CELL_MASK, num_samples, rng, nw);
+        if (s.next_player()) std::swap(nw[0], nw[1]);
+        return {nw[0],nw[1],num_samples};
+    }
+    else return simulate(s, num_samples, rng);
+}
+
+template<class State>
+NodeData simulate_batch(const State& s, int num_samples)
+{
+    return simulate_batch(s, num_samples, playout_rng());
+}
+
 template<size_t BF,class State>
 State naive_analyze(State s, int num_samples, bool second_player = false, typename State::score_type *score = 0)
 {
     using score_type = typename State::score_type;
-    auto it = s.children();
     std::array<State,BF> vs;
     std::array<score_type,BF> vp;
     size_t count = 0;
-    while (it.hasNext())
+    for (int col: expansion_moves(s))
     {
-        State r = it.next();
+        State r = s.make_move(col, s.next_player());
         vs[count] = r;
-        vp[count] = simulate(r,num_samples)();
+        vp[count] = simulate_batch(r,num_samples)();
         ++count;
         //        std::cerr << r.last_column() << ":(" << p.p0 << "," << p.p1 << "," << p.px << ")" << std::endl;
     }
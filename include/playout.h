@@ -0,0 +1,38 @@
+/*
+    Connect Four 2014 (c) 2014 George M. Tzoumas
+
+    This file is part of Connect Four 2014.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// lane-parallel random playouts for boards of one 64-bit word (engine)
+
+#ifndef _PLAYOUT_H_
+#define _PLAYOUT_H_
+
+#include <cstdint>
+
+#include "xoshiro.hpp"
+
+// games played at once by batch_playouts(): 16 (AVX-512), 8 (AVX2) or 1
+int playout_lanes();
+
+// num_samples random games (policy of BasicState::playout) from the position
+// with bitboards mine (side to move) and occ, on the cells of cell_mask;
+// wins[0] counts the games won by the side to move, wins[1] the others
+void batch_playouts(uint64_t mine, uint64_t occ, uint64_t cell_mask,
+                    int num_samples, Xoshiro256& rng, int wins[2]);
+
+#endif
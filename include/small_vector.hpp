@@ -0,0 +1,83 @@
+/*
+    Connect Four 2014 (c) 2014 George M. Tzoumas
+
+    This file is part of Connect Four 2014.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// fixed-capacity vector
+
+#ifndef _SMALL_VECTOR_HPP_
+#define _SMALL_VECTOR_HPP_
+
+#include <array>
+#include <cstddef>
+#include <utility>
+
+template<class T,size_t N>
+class small_vector
+{
+    using Rep = std::array<T,N>;
+
+    size_t _size;
+    Rep _rep;
+public:
+    using value_type = T;
+    using pointer    = T*;
+
+    small_vector(): _size(0) {}
+
+    template<class U>
+    void push_back(U&& x)
+    {
+        _rep[_size++] = std::forward<U>(x);
+    }
+
+    void push_back() { _rep[_size++] = T(); }
+
+    small_vector(const small_vector&) = default;
+
+    small_vector(small_vector&& v):
+        _size(std::exchange(v._size,0)),
+        _rep(std::move(v._rep))
+    {}
+
+    small_vector& operator=(const small_vector&) = default;
+    small_vector& operator=(small_vector&& v)
+    {
+        _rep = std::move(v._rep);
+        _size = std::exchange(v._size, 0);
+        return *this;
+    }
+
+    const T& operator[](size_t i) const { return _rep[i]; }
+    T& operator[](size_t i) { return _rep[i]; }
+
+    auto begin() const { return _rep.begin(); }
+    auto end() const { return _rep.begin() + _size; }
+    auto begin() { return _rep.begin(); }
+    auto end() { return _rep.begin() + _size; }
+
+    const T& front() const  { return _rep.front(); }
+    T& front()              { return _rep.front(); }
+
+    const T& back() const  { return _rep[_size-1]; }
+    T& back()              { return _rep[_size-1]; }
+
+    size_t size() const { return _size; }
+    bool   empty() const { return _size == 0; }
+};
+
+#endif // _SMALL_VECTOR_HPP_
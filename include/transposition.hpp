@@ -0,0 +1,491 @@
+/*
+    Alpha-Beta Tree Search (c) 2014 George M. Tzoumas
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _TRANSPOSITION_HPP_
+#define _TRANSPOSITION_HPP_
+
+// fixed-size transposition table
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "alphabeta.hpp"
+#include "largepages.hpp"
+
+// Power-of-two array of 64-byte buckets (one cache line) of 8-byte entries,
+// allocated once, on huge pages if it can (large_alloc()).  The bucket comes from the low bits of the hash and the
+// entry is recognised by the high 32 bits; on a full bucket the entry of
+// least depth of the oldest generation gives way.  The table can outlive
+// a search: new_search() starts a generation, and entries no search of it
+// has stored go first.
+//
+// Lock-free, for threads searching together: each entry is one 64-bit word,
+// read and written atomically (relaxed), whose high half holds the lock
+// XORed with the low half (score, depth, info).  A word put together from
+// two writes fails the lock check and reads as a miss.  Two threads may
+// store the same position in two slots; find() takes the first.
+//
+// save() writes the table to a snapshot file and map() maps one back in
+// place of the table, read-only (store() and clear() do nothing) or copy
+// on write (changes stay in memory).  The file starts with a header of the
+// format, table size and the Layout of the positions and scores, and map()
+// rejects any other.
+//
+// attach() puts the table in a named POSIX shared-memory object instead,
+// for processes searching together as threads do.  Each entry carries the
+// writer, 0..3 by order of attaching, so that a process can tell its own
+// hits from those on entries of the others (exactly up to four processes).
+class TranspositionTable
+{
+public:
+    // info: bound (bits 0-1, as Bound of alphabeta.hpp, 0 = empty slot),
+    // move + 1 (bits 2-5, 0 = none) and generation (bits 6-7); depth and
+    // writer share a byte
+    struct Entry
+    {
+        uint32_t lock;
+        int16_t  score;
+        uint8_t  depth; // 0..63
+        uint8_t  info;
+        uint8_t  writer;
+
+        int bound() const { return info & 3; }
+        int move() const { return ((info >> 2) & 15) - 1; }
+        int generation() const { return info >> 6; }
+    };
+
+    static constexpr size_t BUCKET_SIZE = 8;
+
+    struct alignas(64) Bucket
+    {
+        std::atomic<uint64_t> word[BUCKET_SIZE];
+    };
+
+    static_assert(sizeof(Bucket) == 64 && std::atomic<uint64_t>::is_always_lock_free);
+
+    static constexpr size_t DEFAULT_BYTES = size_t(64) << 20;
+
+    // what the hashes and scores of a snapshot are of
+    struct Layout
+    {
+        uint32_t width, height;
+        uint32_t score_version;
+    };
+
+    enum Mapping { READ_ONLY, COPY_ON_WRITE };
+
+    // find() calls of this process on a shared table
+    struct Probes
+    {
+        uint64_t probes, hits;
+        uint64_t foreign; // hits on entries of other processes
+    };
+
+    // the largest power of two of buckets within the budget (at least one);
+    // on small pages only unless huge
+    explicit TranspositionTable(size_t bytes = DEFAULT_BYTES, bool huge = true)
+    {
+        const size_t n = buckets(bytes);
+        size_t mapped = n*sizeof(Bucket);
+        void* p = large_alloc(mapped, huge, &_pages);
+        if (!p) throw std::bad_alloc();
+        _mask = n-1;
+        _table = Table(static_cast<Bucket*>(p), Release(mapped, 0));
+    }
+
+    // no buckets, for map() or attach() to fill; nothing else until then
+    struct NoBuckets { };
+    explicit TranspositionTable(NoBuckets): _mask(0) { }
+
+    TranspositionTable(TranspositionTable&& t):
+        _table(std::move(t._table)), _mask(t._mask), _used(t._used.load()), _generation(t._generation),
+        _read_only(t._read_only), _writer(t._writer), _probes(std::move(t._probes)), _pages(t._pages) { }
+
+    bool find(uint64_t hash, Entry& e) const
+    {
+        const uint32_t lock = uint32_t(hash >> 32);
+        if (_probes) _probes->probes.fetch_add(1, std::memory_order_relaxed);
+        for (const auto& w: _table[hash & _mask].word) {
+            e = unpack(w.load(std::memory_order_relaxed));
+            if (e.info && e.lock == lock) {
+                if (_probes) {
+                    _probes->hits.fetch_add(1, std::memory_order_relaxed);
+                    if (e.writer != _writer) _probes->foreign.fetch_add(1, std::memory_order_relaxed);
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // bound 1..3, move -1..14; an entry for the same position is kept if
+    // it has more depth (and joins the current generation)
+    void store(uint64_t hash, int score, int depth, int bound, int move)
+    {
+        if (_read_only) return;
+        const uint32_t lock = uint32_t(hash >> 32);
+        std::atomic<uint64_t>* victim = nullptr;
+        Entry v{};
+        for (auto& w: _table[hash & _mask].word) {
+            const Entry e = unpack(w.load(std::memory_order_relaxed));
+            if (!e.info) {
+                if (!victim || v.info) victim = &w, v = e;
+            } else if (e.lock == lock) {
+                if (e.depth > depth) {
+                    if (e.generation() != _generation)
+                        w.store(pack(Entry{lock, e.score, e.depth, uint8_t((e.info & 63) | _generation << 6),
+                                           e.writer}),
+                                std::memory_order_relaxed);
+                    return;
+                }
+                victim = &w, v = e;
+                break;
+            } else if (!victim || (v.info && (age(e) > age(v) || (age(e) == age(v) && e.depth < v.depth))))
+                victim = &w, v = e;
+        }
+        if (!v.info) _used.fetch_add(1, std::memory_order_relaxed);
+        victim->store(pack(Entry{lock, int16_t(score), uint8_t(depth),
+                                 uint8_t(bound | (move+1) << 2 | _generation << 6), _writer}),
+                      std::memory_order_relaxed);
+    }
+
+    // before a search that keeps the entries of the previous ones; not
+    // while searching
+    void new_search() { _generation = (_generation + 1) & 3; }
+
+    void clear()
+    {
+        if (_read_only) return;
+        for (size_t i = 0; i <= _mask; ++i)
+            for (auto& w: _table[i].word) w.store(0, std::memory_order_relaxed);
+        _used = 0;
+    }
+
+    size_t size() const { return _used.load(std::memory_order_relaxed); }
+    size_t capacity() const { return (_mask+1) * BUCKET_SIZE; }
+    size_t bytes() const { return (_mask+1) * sizeof(Bucket); }
+    bool read_only() const { return _read_only; }
+    bool has_buckets() const { return bool(_table); }
+    bool shared() const { return bool(_probes); }
+    // of the buckets, and how many bytes of them are on transparent huge
+    // pages (the kernel may back advised memory with small ones)
+    PageKind page_kind() const { return _pages; }
+    size_t huge_bytes() const { return _pages == HUGE_PAGES ? bytes() : huge_page_bytes(_table.get()); }
+
+    Probes probes() const
+    {
+        if (!_probes) return Probes{0, 0, 0};
+        return Probes{_probes->probes.load(), _probes->hits.load(), _probes->foreign.load()};
+    }
+
+    // not while searching; through a temporary file renamed over path, so
+    // that tables mapped from an earlier snapshot there keep theirs
+    bool save(const std::string& path, Layout layout) const
+    {
+        const Header h = header(layout, _mask+1, size(), _generation);
+        const std::string tmp = path + ".tmp";
+        FILE* f = std::fopen(tmp.c_str(), "wb");
+        if (!f) return false;
+        bool ok = std::fwrite(&h, sizeof h, 1, f) == 1
+            && std::fwrite(_table.get(), sizeof(Bucket), _mask+1, f) == _mask+1;
+        ok = std::fclose(f) == 0 && ok;
+        if (ok && std::rename(tmp.c_str(), path.c_str()) == 0) return true;
+        std::remove(tmp.c_str());
+        return false;
+    }
+
+    // the table of the snapshot at path instead of this one; false (and
+    // this one kept) if there is none or it is not of this format and layout
+    bool map(const std::string& path, Layout layout, Mapping mapping)
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        Header h;
+        struct stat st;
+        void* p = MAP_FAILED;
+        if (::pread(fd, &h, sizeof h, 0) == ssize_t(sizeof h) && ::fstat(fd, &st) == 0
+            && h.buckets && !(h.buckets & (h.buckets-1))
+            && same(h, header(layout, h.buckets, h.used, h.generation))
+            && uint64_t(st.st_size) == sizeof h + h.buckets * sizeof(Bucket))
+            p = ::mmap(0, st.st_size, mapping == READ_ONLY ? PROT_READ : PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) return false;
+        _table = Table(reinterpret_cast<Bucket*>(static_cast<char*>(p) + sizeof h), Release(st.st_size, sizeof h));
+        _mask = h.buckets-1;
+        _used = h.used;
+        _generation = uint8_t(h.generation);
+        _read_only = mapping == READ_ONLY;
+        _pages = SMALL_PAGES;
+        _writer = 0;
+        _probes.reset();
+        return true;
+    }
+
+    // the table of the shared-memory object name ("/name") instead of this
+    // one, made with the buckets of bytes by the first process to attach,
+    // so that the others take its size; false (and this one kept) if it
+    // cannot be made or is not of this format and layout.  The object
+    // stays until remove_shared().  size() counts the stores of this
+    // process only.
+    bool attach(const std::string& name, size_t bytes, Layout layout)
+    {
+        const size_t n = buckets(bytes);
+        bool made = true;
+        int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0 && errno == EEXIST) made = false, fd = ::shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0) return false;
+        const off_t head = sizeof(Header) + sizeof(Shared);
+        struct stat st;
+        st.st_size = head + n*sizeof(Bucket);
+        const bool sized = made ? ::ftruncate(fd, st.st_size) == 0
+                                : wait_for([&] { return ::fstat(fd, &st) == 0 && st.st_size >= head; });
+        if (!sized) {
+            ::close(fd);
+            if (made) ::shm_unlink(name.c_str());
+            return false;
+        }
+        void* p = ::mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED) {
+            // never ready, so no one else could attach to it
+            if (made) ::shm_unlink(name.c_str());
+            return false;
+        }
+        Header& h = *static_cast<Header*>(p);
+        Shared& shared = *reinterpret_cast<Shared*>(static_cast<char*>(p) + sizeof(Header));
+        if (made) {
+            // the buckets are zero already
+            h = header(layout, n, 0, 0);
+            shared.ready.store(1, std::memory_order_release);
+        }
+        else if (!wait_for([&] { return shared.ready.load(std::memory_order_acquire) != 0; })
+                 || !same(h, header(layout, h.buckets, 0, 0)) || !h.buckets || (h.buckets & (h.buckets-1))
+                 || uint64_t(st.st_size) != head + h.buckets * sizeof(Bucket)) {
+            ::munmap(p, st.st_size);
+            return false;
+        }
+        _table = Table(reinterpret_cast<Bucket*>(static_cast<char*>(p) + head), Release(st.st_size, head));
+        _mask = h.buckets-1;
+        _used = 0;
+        _read_only = false;
+        _pages = SMALL_PAGES;
+        _writer = uint8_t(shared.attached.fetch_add(1) & 3);
+        _probes.reset(new Counters());
+        return true;
+    }
+
+    static bool remove_shared(const std::string& name) { return ::shm_unlink(name.c_str()) == 0; }
+
+    // murmur3 finaliser: spreads the (possibly perfect) key hash over both halves
+    static uint64_t mix(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCD;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53;
+        h ^= h >> 33;
+        return h;
+    }
+
+private:
+    static constexpr uint32_t FORMAT = 2; // 2: writer in the depth byte
+
+    // of a snapshot, one bucket long so that the buckets mapped after it
+    // stay aligned
+    struct alignas(64) Header
+    {
+        char     magic[8];
+        uint32_t format;
+        Layout   layout;
+        uint64_t buckets;
+        uint64_t used;
+        uint32_t generation;
+    };
+
+    static_assert(sizeof(Header) == sizeof(Bucket));
+
+    static Header header(Layout layout, uint64_t buckets, uint64_t used, uint32_t generation)
+    {
+        Header h;
+        std::memset(&h, 0, sizeof h); // padding too, for same()
+        std::memcpy(h.magic, "C4TTSNAP", sizeof h.magic);
+        h.format = FORMAT;
+        h.layout = layout;
+        h.buckets = buckets;
+        h.used = used;
+        h.generation = generation;
+        return h;
+    }
+
+    static bool same(const Header& a, const Header& b) { return std::memcmp(&a, &b, sizeof a) == 0; }
+
+    // of a shared table, after its header
+    struct alignas(64) Shared
+    {
+        std::atomic<uint32_t> ready;    // header written
+        std::atomic<uint32_t> attached; // processes so far
+    };
+
+    struct Counters
+    {
+        std::atomic<uint64_t> probes{0}, hits{0}, foreign{0};
+    };
+
+    // unmaps the buckets (bytes mapped, the buckets offset after the start)
+    struct Release
+    {
+        Release(): mapped(0), offset(0) { }
+        Release(size_t bytes, size_t offset): mapped(bytes), offset(offset) { }
+
+        size_t mapped, offset;
+
+        void operator()(Bucket* b) const { large_free(reinterpret_cast<char*>(b) - offset, mapped); }
+    };
+
+    static size_t buckets(size_t bytes)
+    {
+        size_t n = 1;
+        while (2*n*sizeof(Bucket) <= bytes) n *= 2;
+        return n;
+    }
+
+    // polls ready() for up to a second, for a process still making a
+    // shared table
+    template<class Ready>
+    static bool wait_for(Ready ready)
+    {
+        for (int i = 0; i < 1000; ++i) {
+            if (ready()) return true;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return ready();
+    }
+
+    using Table = std::unique_ptr<Bucket[], Release>;
+
+    // searches since the entry was stored (modulo 4)
+    int age(Entry e) const { return (_generation - e.generation()) & 3; }
+
+    static uint64_t pack(Entry e)
+    {
+        const uint32_t data = uint16_t(e.score) | uint32_t(e.depth | e.writer << 6) << 16 | uint32_t(e.info) << 24;
+        return uint64_t(e.lock ^ data) << 32 | data;
+    }
+
+    static Entry unpack(uint64_t w)
+    {
+        const uint32_t data = uint32_t(w);
+        return Entry{uint32_t(w >> 32) ^ data, int16_t(data), uint8_t((data >> 16) & 63), uint8_t(data >> 24),
+                     uint8_t((data >> 22) & 3)};
+    }
+
+    Table _table;
+    size_t _mask;
+    std::atomic<size_t> _used{0};
+    uint8_t _generation = 0;
+    bool _read_only = false;
+    uint8_t _writer = 0;
+    std::unique_ptr<Counters> _probes; // shared tables only
+    PageKind _pages = SMALL_PAGES;
+};
+
+// caching policy for alpha_beta_cache over a TranspositionTable; scores are
+// the integers of the evaluation (heuristic or a win, 1000 and up), which fit
+// in 16 bits;
+// safe to share between threads
+template<class State>
+struct TTPolicy
+{
+    static_assert(State::MAX_DEPTH < 64, "depths are 6 bits");
+
+    using Score = typename State::score_type;
+    using Entry = CacheEntry<Score>;
+
+    explicit TTPolicy(size_t bytes = TranspositionTable::DEFAULT_BYTES, bool huge_pages = true):
+        _table(bytes, huge_pages) { }
+
+    // mirror images share an entry, as in DefaultPolicy
+    Entry lookup(State s) const {
+        TranspositionTable::Entry e;
+        if (!_table.find(hash(s), e)) return Entry{Score(), 0, NO_BOUND, -1};
+        return Entry{Score(e.score), e.depth, Bound(e.bound()), canonical_move(s, e.move())};
+    }
+
+    void insert(State s, Entry e)
+    {
+        _table.store(hash(s), int(e.score), e.depth, e.bound, canonical_move(s, e.move));
+    }
+
+    size_t size() const { return _table.size(); }
+    const TranspositionTable& table() const { return _table; }
+
+    // the entries stay, but the next stores replace those of earlier
+    // searches first
+    void new_search() { _table.new_search(); }
+
+    // snapshots of this board and scoring (TranspositionTable); mapped()
+    // is null if there is none at path
+    bool save(const std::string& path) const { return _table.save(path, layout()); }
+    static std::unique_ptr<TTPolicy> mapped(const std::string& path, TranspositionTable::Mapping mapping)
+    {
+        std::unique_ptr<TTPolicy> p(new TTPolicy(TranspositionTable(TranspositionTable::NoBuckets())));
+        if (!p->_table.map(path, layout(), mapping)) p.reset();
+        return p;
+    }
+
+    // shared memory of this board and scoring (TranspositionTable); null if
+    // it cannot be attached
+    static std::unique_ptr<TTPolicy> attached(const std::string& name, size_t bytes)
+    {
+        std::unique_ptr<TTPolicy> p(new TTPolicy(TranspositionTable(TranspositionTable::NoBuckets())));
+        if (!p->_table.attach(name, bytes, layout())) p.reset();
+        return p;
+    }
+
+private:
+    explicit TTPolicy(TranspositionTable&& table): _table(std::move(table)) { }
+
+    static TranspositionTable::Layout layout()
+    {
+        return {State::WIDTH, State::HEIGHT, State::SCORE_VERSION};
+    }
+
+    static uint64_t hash(State s)
+    {
+        return TranspositionTable::mix(typename State::KeyHasher()(s.canonical_key()));
+    }
+
+    TranspositionTable _table;
+};
+
+#endif // _TRANSPOSITION_HPP_
@@ -0,0 +1,79 @@
+/*
+    Connect Four 2014 (c) 2014 George M. Tzoumas
+
+    This file is part of Connect Four 2014.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// xoshiro256** pseudo-random generator (Blackman & Vigna)
+
+#ifndef _XOSHIRO_HPP_
+#define _XOSHIRO_HPP_
+
+#include <cstdint>
+
+class Xoshiro256
+{
+    uint64_t s[4];
+
+    static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+public:
+    using result_type = uint64_t;
+
+    explicit Xoshiro256(uint64_t seed = 1) { this->seed(seed); }
+
+    // state filled by splitmix64, so any seed (even 0) is fine
+    void seed(uint64_t seed)
+    {
+        for (auto& x: s) {
+            uint64_t z = (seed += 0x9E3779B97F4A7C15);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+            x = z ^ (z >> 31);
+        }
+    }
+
+    uint64_t operator()()
+    {
+        const uint64_t result = rotl(s[1] * 5, 7) * 9;
+        const uint64_t t = s[1] << 17;
+        s[2] ^= s[0];
+        s[3] ^= s[1];
+        s[1] ^= s[2];
+        s[0] ^= s[3];
+        s[2] ^= t;
+        s[3] = rotl(s[3], 45);
+        return result;
+    }
+
+    // 0..n-1, by multiply-shift of the high 32 bits
+    unsigned below(unsigned n)
+    {
+        return unsigned(((operator()() >> 32) * n) >> 32);
+    }
+
+    static constexpr uint64_t min() { return 0; }
+    static constexpr uint64_t max() { return UINT64_MAX; }
+};
+
+// one generator per thread for playouts; seed it for reproducible runs
+inline Xoshiro256& playout_rng()
+{
+    thread_local Xoshiro256 rng;
+    return rng;
+}
+
+#endif // _XOSHIRO_HPP_
@@ -0,0 +1,256 @@
+/*
+    Alpha-Beta Tree Search (c) 2014 George M. Tzoumas
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _YBW_HPP_
+#define _YBW_HPP_
+
+// Young Brothers Wait: parallel alpha-beta over a work-stealing pool
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "alphabeta.hpp"
+
+// Worker threads with a deque of tasks each.  A worker takes the newest
+// task of its own deque and, when that is empty, steals the oldest of
+// another.  The thread that makes the pool is worker 0 and runs tasks only
+// inside wait(); the others look for work until the pool is destroyed.
+class WorkStealingPool
+{
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkStealingPool(int workers):
+        _size(workers > 0 ? workers : 1), _queues(new Queue[_size])
+    {
+        current() = 0;
+        for (int i = 1; i < _size; ++i)
+            _threads.emplace_back([this, i] {
+                current() = i;
+                while (!_stop.load(std::memory_order_relaxed))
+                    if (!run_one(i)) std::this_thread::yield();
+            });
+    }
+
+    ~WorkStealingPool()
+    {
+        _stop = true;
+        for (auto& t: _threads) t.join();
+    }
+
+    int size() const { return _size; }
+
+    // the worker of the calling thread
+    int worker() const { return current(); }
+
+    // onto the deque of the calling thread's worker
+    void push(Task t)
+    {
+        Queue& q = _queues[worker()];
+        std::lock_guard<std::mutex> lock(q.m);
+        q.tasks.push_back(std::move(t));
+    }
+
+    // runs tasks, own or stolen, until done()
+    template<class Done>
+    void wait(Done done)
+    {
+        const int self = worker();
+        while (!done())
+            if (!run_one(self)) std::this_thread::yield();
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex m;
+        std::deque<Task> tasks;
+    };
+
+    static int& current()
+    {
+        thread_local int w = 0;
+        return w;
+    }
+
+    bool run_one(int self)
+    {
+        Task t;
+        for (int k = 0; k < _size && !t; ++k) {
+            const int i = (self + k) % _size;
+            Queue& q = _queues[i];
+            std::lock_guard<std::mutex> lock(q.m);
+            if (q.tasks.empty()) continue;
+            if (i == self) t = std::move(q.tasks.back()), q.tasks.pop_back();
+            else t = std::move(q.tasks.front()), q.tasks.pop_front();
+        }
+        if (!t) return false;
+        t();
+        return true;
+    }
+
+    int _size;
+    std::unique_ptr<Queue[]> _queues;
+    std::vector<std::thread> _threads;
+    std::atomic<bool> _stop{false};
+};
+
+// The negamax of alphabeta.hpp with its nodes of remaining depth at least
+// split_depth searched in parallel: the first move alone, then the others
+// (the young brothers) as tasks of the pool, each with a null window at
+// the best score so far and a re-search if it beats it.  A brother that
+// cuts off raises the flag of the node, which stops the brothers still
+// searching and all the searches nested in them.  Nodes below split_depth
+// are plain negamax.  The cache is shared, so it has to be thread-safe
+// (TTPolicy).
+template<class State, class CachingPolicy, class Evaluation>
+class YoungBrothersWait
+{
+public:
+    using Score = typename State::score_type;
+    using Acc = typename Evaluation::Acc;
+
+    YoungBrothersWait(CachingPolicy &cache, WorkStealingPool &pool, int split_depth):
+        _cache(cache), _pool(pool), _split_depth(split_depth), _nodes(new Counter[pool.size()]) { }
+
+    template<int Side>
+    Score search(State s, Acc acc, Score alpha, Score beta, int depth, State *best, const StopFlag *stop)
+    {
+        if (depth < _split_depth)
+        {
+            Deadline deadline(Deadline::clock_type::time_point::max(), stop);
+            return negamax<Side>(s, acc, _eval, _cache, alpha, beta, depth, best, moves(), &deadline);
+        }
+        if (stop && stop->is_raised()) throw SearchTimeout();
+        Score v;
+        typename State::move_list cols;
+        if (settle<Side>(s, acc, _eval, _cache, &alpha, &beta, depth, best != 0, (MoveOrdering<State>*)0, &v, &cols))
+            return v;
+        Split split;
+        split.flag.parent = stop;
+        split.alpha = alpha;
+        const Score alpha0 = alpha;
+
+        // the eldest brother first, alone
+        State r = s.make_move(cols.front(), Side);
+        ++*moves();
+        split.best_score = -search<1-Side>(r, _eval.move(acc, s, r), -beta, -alpha, depth-1, (State*)0, stop);
+        split.best_state = r;
+        if (split.best_score > split.alpha) split.alpha = split.best_score;
+
+        if (split.alpha < beta && cols.size() > 1)
+        {
+            std::atomic<int> pending(int(cols.size())-1);
+            // last first, so that this worker takes them in order
+            for (size_t i = cols.size()-1; i > 0; --i)
+                _pool.push([&, col = cols[i]] {
+                    brother<Side>(s, acc, col, beta, depth, split);
+                    --pending;
+                });
+            _pool.wait([&] { return pending.load() == 0; });
+            // an abandoned node has nothing to store or return
+            if (stop && stop->is_raised()) throw SearchTimeout();
+        }
+        if (best) *best = split.best_state;
+        store_result<Side>(_cache, s, split.best_score, alpha0, beta, depth, split.best_state);
+        return split.best_score;
+    }
+
+    long long nodes() const
+    {
+        long long n = 0;
+        for (int i = 0; i < _pool.size(); ++i) n += _nodes[i].n;
+        return n;
+    }
+
+private:
+    struct alignas(64) Counter { int n = 0; };
+
+    // the state shared by the brothers of a node
+    struct Split
+    {
+        StopFlag flag;
+        Score alpha = State::MINUS_INFINITY;
+        Score best_score = State::MINUS_INFINITY;
+        State best_state;
+        std::mutex m;
+    };
+
+    template<int Side>
+    void brother(State s, Acc acc, int col, Score beta, int depth, Split &split)
+    {
+        if (split.flag.is_raised()) return;
+        State r = s.make_move(col, Side);
+        ++*moves();
+        const Acc racc = _eval.move(acc, s, r);
+        try {
+            Score alpha = current_alpha(split);
+            Score val = -search<1-Side>(r, racc, -alpha-1, -alpha, depth-1, (State*)0, &split.flag);
+            alpha = current_alpha(split);
+            if (alpha < val && val < beta)
+                val = -search<1-Side>(r, racc, -beta, -alpha, depth-1, (State*)0, &split.flag);
+            std::lock_guard<std::mutex> lock(split.m);
+            if (val > split.best_score) split.best_score = val, split.best_state = r;
+            if (val > split.alpha) split.alpha = val;
+            if (split.alpha >= beta) split.flag.raised = true;
+        } catch (const SearchTimeout&) {
+            // cut off by a brother, here or higher up
+        }
+    }
+
+    static Score current_alpha(Split &split)
+    {
+        std::lock_guard<std::mutex> lock(split.m);
+        return split.alpha;
+    }
+
+    int *moves() { return &_nodes[_pool.worker()].n; }
+
+    CachingPolicy &_cache;
+    WorkStealingPool &_pool;
+    const int _split_depth;
+    Evaluation _eval;
+    std::unique_ptr<Counter[]> _nodes; // per worker
+};
+
+// alpha_beta_cache() on threads workers, the calling thread included; nodes
+// of remaining depth at least split_depth have their brothers searched in
+// parallel
+template<class State, class CachingPolicy, class Evaluation = FullEval<State> >
+typename State::score_type ybw_alpha_beta_cache(State s, CachingPolicy &cache, typename State::score_type alpha,
+                                                typename State::score_type beta, bool max, bool second_player,
+                                                int max_depth, int threads, State *best = 0, int *moves = 0,
+                                                int split_depth = 8)
+{
+    if (!max) return -ybw_alpha_beta_cache<State,CachingPolicy,Evaluation>(s, cache, -beta, -alpha, true, !second_player,
+                                                                           max_depth, threads, best, moves, split_depth);
+    WorkStealingPool pool(threads);
+    YoungBrothersWait<State,CachingPolicy,Evaluation> ybw(cache, pool, split_depth);
+    Evaluation eval;
+    const auto score = second_player
+        ? ybw.template search<1>(s, eval.root(s), alpha, beta, max_depth, best, (StopFlag*)0)
+        : ybw.template search<0>(s, eval.root(s), alpha, beta, max_depth, best, (StopFlag*)0);
+    if (moves) *moves += ybw.nodes();
+    return score;
+}
+
+#endif // _YBW_HPP_
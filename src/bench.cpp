@@ -0,0 +1,482 @@
+/*
+    Connect Four 2014 (c) 2014 George M. Tzoumas
+
+    This file is part of Connect Four 2014.
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+// headless engine benchmark
+
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "arguments.hpp"
+#include "connect4.hpp"
+#include "alphabeta.hpp"
+#include "transposition.hpp"
+#include "ybw.hpp"
+#include "mcts.hpp"
+
+struct Options
+{
+    int depth = 8;
+    int samples = 2000;
+    unsigned seed = 1;
+    bool incremental = false;
+    bool ordering = false; // killer and history move ordering
+    int tt = 0; // MB, 0: DefaultPolicy
+    double time = 0; // seconds per position for iterative deepening up to depth, 0: fixed depth
+    bool solve = false; // mid-game positions searched to the end of the game
+    bool hard = false; // as solve, positions of more than 10s single-threaded
+    bool exact = false; // exact values (solve()) instead of alpha-beta and MCTS
+    std::string position; // this one (column digits) instead of a set
+    int threads = 0; // Lazy SMP with 1, 2, 4, ... threads up to this, 0: single-threaded
+    bool ybw = false; // Young Brothers Wait to a fixed depth instead of Lazy SMP
+    int split = 8; // least remaining depth of a YBW split
+    bool replay = false; // iterative deepening over every position of GAMES
+    int aspiration = ASPIRATION; // half-width of the aspiration windows, 0: full window
+    bool session = false; // self-play with a table per move and with one table per game
+    std::string load; // --exact: snapshot to start from (one table for all positions)
+    std::string save; // --exact: snapshot to write at the end (one table for all positions)
+    bool read_only = false; // --load mapped read-only instead of copy-on-write
+    std::string shm; // --exact: shared-memory table of this name, made of --tt MB by the first process
+    bool shm_remove = false; // remove --shm at the end
+    bool small_pages = false; // tables on small pages only, not huge ones
+    bool deadlines = false; // check that timed searches return their last reported score
+    std::string board = "7x6";
+};
+
+// moves as column digits 1..7, as on the keyboard
+static const char* POSITIONS[] = {
+    "4", "44", "4453", "43443", "4455", "5434", "12344321", "4444435"
+};
+
+// random 12-disc games, none over or with a win on the next move
+static const char* SOLVE_POSITIONS[] = {
+    "422655351174", "755633152442", "652227536777", "363216657672",
+    "234537643334", "773265761341", "745665572141", "552766124213",
+    "247273622463", "132513475152", "755177475616", "447661731236"
+};
+
+// random 6-disc games, 15-17s to solve on one thread
+static const char* HARD_POSITIONS[] = {
+    "567773", "236411"
+};
+
+// engine self-play (depth 12) after the first move or moves given
+static const char* GAMES[] = {
+    "44444423333326225625553662556611111177",
+    "434444337636664363621222225555551711117777",
+    "454444551252224525261666116333333611777777",
+    "334533543442214435555261222111177777766",
+    "525556531232233632766644443562441111177777",
+    "413242253335535255144442732766666611117777"
+};
+
+static std::vector<const char*> positions(const Options& opt)
+{
+    if (!opt.position.empty()) return {opt.position.c_str()};
+    if (opt.hard) return std::vector<const char*>(std::begin(HARD_POSITIONS), std::end(HARD_POSITIONS));
+    if (opt.solve) return std::vector<const char*>(std::begin(SOLVE_POSITIONS), std::end(SOLVE_POSITIONS));
+    return std::vector<const char*>(std::begin(POSITIONS), std::end(POSITIONS));
+}
+
+template<class State>
+static State from_moves(const std::string& moves)
+{
+    State s;
+    for (char c: moves) s = s.make_move(c-'1', s.next_player());
+    return s;
+}
+
+using clock_type = std::chrono::steady_clock;
+
+static double seconds_since(clock_type::time_point t0)
+{
+    std::chrono::duration<double> dur = clock_type::now()-t0;
+    return dur.count();
+}
+
+// the pages of a table, after searching on it
+template<class Policy>
+static void report_pages(const Policy&) { }
+
+template<class State>
+static void report_pages(const TTPolicy<State>& cache)
+{
+    const auto& t = cache.table();
+    std::cout << "PAGES: " << page_kind_name(t.page_kind()) << ", " << (t.huge_bytes() >> 20) << " of "
+              << (t.bytes() >> 20) << " MB on huge pages" << std::endl;
+}
+
+template<class State, class Evaluation, class Policy>
+static void bench_alphabeta(const Options& opt, std::function<Policy()> make_policy)
+{
+    long long total = 0;
+    double total_time = 0;
+    const auto set = positions(opt);
+    for (auto pos: set) {
+        State s = from_moves<State>(pos), q;
+        const int depth = opt.solve || opt.hard ? s.empty_space() : opt.depth;
+        int moves = 0;
+        Policy cache = make_policy();
+        MoveOrdering<State> ordering;
+        MoveOrdering<State> *mo = opt.ordering ? &ordering : 0;
+        auto t0 = clock_type::now();
+        typename State::score_type val;
+        if (opt.time > 0) {
+            auto report = [&](int depth, typename State::score_type v, const State& r, int nodes) {
+                std::cout << "ID " << pos << ": depth = " << depth << " col = " << r.last_column()+1 << " score = " << v
+                          << " nodes = " << nodes << " time = " << seconds_since(t0) << 's' << std::endl;
+            };
+            val = iterative_deepening<State,Policy,Evaluation>(s, cache, opt.time, depth, &q, &moves, report, mo,
+                                                               opt.aspiration);
+        }
+        else val = alpha_beta_cache<State,Policy,Evaluation>(s, cache, State::MINUS_INFINITY, State::PLUS_INFINITY,
+                                                             true, s.next_player(), depth, 0, &q, &moves, mo);
+        double t = seconds_since(t0);
+        std::cout << "AB " << pos << ": col = " << q.last_column()+1 << " score = " << val
+                  << " nodes = " << moves << " entries = " << cache.size() << " time = " << t << 's' << std::endl;
+        if (pos == set.back()) report_pages(cache);
+        total += moves;
+        total_time += t;
+    }
+    if (opt.solve || opt.hard) std::cout << "AB solve: ";
+    else if (opt.time > 0) std::cout << "AB time " << opt.time << "s: ";
+    else std::cout << "AB depth " << opt.depth << ": ";
+    std::cout << total << " nodes in " << total_time << "s, " << total/total_time << " nodes/s" << std::endl;
+}
+
+// iterative deepening to --depth (or for --time) from every position of
+// GAMES, as the game does move after move, with aspiration windows of
+// --aspiration and with full windows
+template<class State, class Evaluation, class Policy>
+static void bench_replay(const Options& opt, std::function<Policy()> make_policy)
+{
+    const double seconds = opt.time > 0 ? opt.time : 1e9;
+    long long total[2] = {0, 0};
+    double total_time[2] = {0, 0};
+    for (int full = 0; full < 2; ++full) {
+        const int aspiration = full ? 0 : opt.aspiration;
+        for (std::string game: GAMES) {
+            long long nodes = 0;
+            auto t0 = clock_type::now();
+            for (size_t n = 0; n < game.size(); ++n) {
+                State s = from_moves<State>(game.substr(0, n)), q;
+                Policy cache = make_policy();
+                int moves = 0;
+                iterative_deepening<State,Policy,Evaluation>(s, cache, seconds, opt.depth, &q, &moves,
+                                                             [](int, typename State::score_type, const State&, int) { },
+                                                             (MoveOrdering<State>*)0, aspiration);
+                nodes += moves;
+            }
+            double t = seconds_since(t0);
+            std::cout << "REPLAY aspiration " << aspiration << ' ' << game << ": nodes = " << nodes
+                      << " time = " << t << 's' << std::endl;
+            total[full] += nodes;
+            total_time[full] += t;
+        }
+        std::cout << "REPLAY aspiration " << aspiration << ": " << total[full] << " nodes in " << total_time[full] << "s"
+                  << std::endl;
+    }
+    std::cout << "REPLAY aspiration saves " << 100.0 * (total[1]-total[0]) / total[1] << "% of the nodes" << std::endl;
+}
+
+// iterative deepening from every position of GAMES with deadlines of 1 to
+// 8 ms, so that many run out of time in an aspiration re-search: each must
+// return the score it last reported.  Returns the number that do not.
+template<class State, class Evaluation>
+static int check_deadlines(const Options& opt)
+{
+    const size_t bytes = size_t(opt.tt ? opt.tt : 16) << 20;
+    int searches = 0, bad = 0;
+    for (std::string game: GAMES)
+        for (size_t n = 0; n < game.size(); ++n)
+            for (double seconds: {0.001, 0.002, 0.004, 0.008}) {
+                State s = from_moves<State>(game.substr(0, n)), q;
+                TTPolicy<State> cache(bytes, !opt.small_pages);
+                typename State::score_type reported = 0;
+                int moves = 0;
+                const auto val = iterative_deepening<State,TTPolicy<State>,Evaluation>(
+                    s, cache, seconds, State::MAX_DEPTH, &q, &moves,
+                    [&](int, typename State::score_type v, const State&, int) { reported = v; },
+                    (MoveOrdering<State>*)0, opt.aspiration);
+                ++searches;
+                if (val != reported) {
+                    ++bad;
+                    std::cout << "DEADLINE " << game.substr(0, n) << " " << seconds << "s: returned " << val
+                              << ", last reported " << reported << std::endl;
+                }
+            }
+    std::cout << "DEADLINES: " << searches << " searches, " << bad << " not returning the last reported score"
+              << std::endl;
+    return bad;
+}
+
+// self-play from the first two moves of each of GAMES, each move by
+// iterative deepening to --depth (or for --time) on a table of --tt MB (64
+// if 0): a new table for every move, then one table for the whole game as
+// the game keeps it
+template<class State, class Evaluation>
+static void bench_session(const Options& opt)
+{
+    const size_t bytes = size_t(opt.tt ? opt.tt : 64) << 20;
+    const double seconds = opt.time > 0 ? opt.time : 1e9;
+    double per_move[2] = {0, 0};
+    for (int keep = 0; keep < 2; ++keep) {
+        const char* tag = keep ? "SESSION" : "PER MOVE";
+        long long total = 0;
+        double total_time = 0, slowest = 0;
+        int plies = 0;
+        for (std::string game: GAMES) {
+            State s = from_moves<State>(game.substr(0, 2));
+            std::string line = game.substr(0, 2);
+            TTPolicy<State> session(bytes, !opt.small_pages);
+            auto t0 = clock_type::now();
+            while (!s.is_terminal()) {
+                std::unique_ptr<TTPolicy<State>> fresh(keep ? 0 : new TTPolicy<State>(bytes, !opt.small_pages));
+                TTPolicy<State>& cache = keep ? session : *fresh;
+                cache.new_search();
+                State q;
+                int moves = 0;
+                auto t1 = clock_type::now();
+                iterative_deepening<State,TTPolicy<State>,Evaluation>(s, cache, seconds, opt.depth, &q, &moves,
+                                                                      [](int, typename State::score_type, const State&, int) { });
+                slowest = std::max(slowest, seconds_since(t1));
+                total += moves;
+                ++plies;
+                line += char('1' + q.last_column());
+                s = q;
+            }
+            double t = seconds_since(t0);
+            std::cout << tag << ' ' << line << ": time = " << t << 's' << std::endl;
+            total_time += t;
+        }
+        per_move[keep] = total_time / plies;
+        std::cout << tag << ": " << plies << " moves, " << total << " nodes in " << total_time << "s, "
+                  << per_move[keep] << "s per move, slowest " << slowest << 's' << std::endl;
+    }
+    std::cout << "SESSION table saves " << 100.0 * (per_move[0]-per_move[1]) / per_move[0]
+              << "% of the time per move" << std::endl;
+}
+
+// time to depth (or to the end with --solve) and nodes/s of lazy_smp() or
+// ybw_alpha_beta_cache() on a table of --tt MB (64 if 0) for 1, 2, 4, ...
+// threads
+template<class State, class Evaluation>
+static void bench_smp(const Options& opt)
+{
+    const size_t bytes = size_t(opt.tt ? opt.tt : 64) << 20;
+    const double seconds = opt.time > 0 ? opt.time : 1e9;
+    const char* tag = opt.ybw ? "YBW" : "SMP";
+    double base = 0;
+    for (int threads = 1; ; threads = std::min(2*threads, opt.threads)) {
+        long long total = 0;
+        double total_time = 0;
+        const auto set = positions(opt);
+        for (auto pos: set) {
+            State s = from_moves<State>(pos), q;
+            const int depth = opt.solve || opt.hard ? s.empty_space() : opt.depth;
+            TTPolicy<State> cache(bytes, !opt.small_pages);
+            int moves = 0;
+            auto t0 = clock_type::now();
+            typename State::score_type val;
+            if (opt.ybw) val = ybw_alpha_beta_cache<State,TTPolicy<State>,Evaluation>(
+                                   s, cache, State::MINUS_INFINITY, State::PLUS_INFINITY, true, s.next_player(),
+                                   depth, threads, &q, &moves, opt.split);
+            else val = lazy_smp<State,TTPolicy<State>,Evaluation>(s, cache, seconds, depth, threads, &q, &moves,
+                                                                  [](int, typename State::score_type, const State&, int) { });
+            double t = seconds_since(t0);
+            std::cout << tag << ' ' << threads << ' ' << pos << ": col = " << q.last_column()+1 << " score = " << val
+                      << " nodes = " << moves << " time = " << t << 's' << std::endl;
+            if (pos == set.back()) report_pages(cache);
+            total += moves;
+            total_time += t;
+        }
+        if (threads == 1) base = total_time;
+        std::cout << tag << ' ' << threads << " threads: " << total << " nodes in " << total_time << "s, "
+                  << total/total_time << " nodes/s, speedup " << base/total_time << std::endl;
+        if (threads == opt.threads) break;
+    }
+}
+
+// exact value, time to solve and nodes of each position with a table of
+// --tt MB (64 if 0); with --load, --save or --shm, one table for all of
+// them, mapped from --load or shared as --shm, and written to --save
+template<class State>
+static void bench_solve(const Options& opt)
+{
+    const size_t bytes = size_t(opt.tt ? opt.tt : 64) << 20;
+    const bool keep = !opt.load.empty() || !opt.save.empty() || !opt.shm.empty();
+    std::unique_ptr<TTPolicy<State>> kept;
+    if (!opt.shm.empty()) {
+        kept = TTPolicy<State>::attached(opt.shm, bytes);
+        if (!kept) {
+            std::cerr << "error: cannot share a table of this board and scoring as " << opt.shm << std::endl;
+            return;
+        }
+        std::cout << "SHARED " << opt.shm << ": " << kept->table().bytes() << " bytes" << std::endl;
+    }
+    else if (!opt.load.empty()) {
+        auto t0 = clock_type::now();
+        kept = TTPolicy<State>::mapped(opt.load, opt.read_only ? TranspositionTable::READ_ONLY
+                                                               : TranspositionTable::COPY_ON_WRITE);
+        if (!kept) {
+            std::cerr << "error: no snapshot of this board and scoring in " << opt.load << std::endl;
+            return;
+        }
+        std::cout << "SNAPSHOT " << opt.load << ": " << kept->size() << " entries, "
+                  << kept->table().bytes() << " bytes mapped in " << seconds_since(t0) << 's' << std::endl;
+    }
+    else if (keep) kept.reset(new TTPolicy<State>(bytes, !opt.small_pages));
+    long long total = 0;
+    double total_time = 0;
+    const auto set = positions(opt);
+    for (auto pos: set) {
+        State s = from_moves<State>(pos), q;
+        std::unique_ptr<TTPolicy<State>> fresh(keep ? 0 : new TTPolicy<State>(bytes, !opt.small_pages));
+        TTPolicy<State>& cache = keep ? *kept : *fresh;
+        int moves = 0;
+        auto t0 = clock_type::now();
+        const int val = solve(s, cache, &q, &moves);
+        double t = seconds_since(t0);
+        // plies from pos to the winning move
+        const int plies = s.empty_space() - (std::abs(val) - State::WIN_SCORE);
+        std::cout << "EXACT " << pos << ": col = " << q.last_column()+1 << " score = " << val << " (";
+        if (val > 0) std::cout << "win in " << plies;
+        else if (val < 0) std::cout << "loss in " << plies;
+        else std::cout << "draw";
+        std::cout << ") nodes = " << moves << " time = " << t << 's' << std::endl;
+        if (pos == set.back()) report_pages(cache);
+        total += moves;
+        total_time += t;
+    }
+    std::cout << "EXACT: " << total << " nodes in " << total_time << "s, " << total/total_time << " nodes/s" << std::endl;
+    if (kept && kept->table().shared()) {
+        const auto p = kept->table().probes();
+        std::cout << "SHARED " << opt.shm << ": " << p.probes << " probes, hits " << 100.0 * p.hits / p.probes
+                  << "%, of other processes " << 100.0 * p.foreign / p.probes << '%' << std::endl;
+        if (opt.shm_remove) TranspositionTable::remove_shared(opt.shm);
+    }
+    if (!opt.save.empty()) {
+        auto t0 = clock_type::now();
+        if (kept->save(opt.save))
+            std::cout << "SNAPSHOT " << opt.save << ": " << kept->size() << " entries written in "
+                      << seconds_since(t0) << 's' << std::endl;
+        else std::cerr << "error: cannot write snapshot " << opt.save << std::endl;
+    }
+}
+
+template<class State, class Simulate>
+static void bench_mcts(const Options& opt, const char* tag, Simulate simulate)
+{
+    double total_time = 0;
+    for (auto pos: POSITIONS) {
+        State s = from_moves<State>(pos);
+        auto t0 = clock_type::now();
+        auto res = simulate(s, opt.samples);
+        double t = seconds_since(t0);
+        std::cout << tag << ' ' << pos << ": " << res;
+        total_time += t;
+    }
+    const double total = double(opt.samples) * std::size(POSITIONS);
+    std::cout << tag << ' ' << total << " playouts in " << total_time << "s, "
+              << total/total_time << " playouts/s" << std::endl;
+}
+
+template<class State, class Policy>
+static void bench_policy(const Options& opt, std::function<Policy()> make_policy)
+{
+    if (opt.replay) {
+        if (opt.incremental) bench_replay<State,IncrementalEval<State>>(opt, make_policy);
+        else bench_replay<State,FullEval<State>>(opt, make_policy);
+    }
+    else if (opt.incremental) bench_alphabeta<State,IncrementalEval<State>>(opt, make_policy);
+    else bench_alphabeta<State,FullEval<State>>(opt, make_policy);
+}
+
+template<class State>
+static int bench(const Options& opt)
+{
+    if (opt.deadlines)
+        return opt.incremental ? check_deadlines<State,IncrementalEval<State>>(opt) != 0
+                               : check_deadlines<State,FullEval<State>>(opt) != 0;
+    if (opt.exact) {
+        bench_solve<State>(opt);
+        return 0;
+    }
+    if (opt.session) {
+        if (opt.incremental) bench_session<State,IncrementalEval<State>>(opt);
+        else bench_session<State,FullEval<State>>(opt);
+        return 0;
+    }
+    if (opt.threads > 0) {
+        if (opt.incremental) bench_smp<State,IncrementalEval<State>>(opt);
+        else bench_smp<State,FullEval<State>>(opt);
+    }
+    else if (opt.tt) bench_policy<State,TTPolicy<State>>(opt, [&] { return TTPolicy<State>(size_t(opt.tt) << 20, !opt.small_pages); });
+    else bench_policy<State,DefaultPolicy<State>>(opt, [] { return DefaultPolicy<State>(); });
+    bench_mcts<State>(opt, "MC", [](const State& s, int n) { return mcts::simulate(s, n); });
+    bench_mcts<State>(opt, "MCx", [](const State& s, int n) { return mcts::simulate_batch(s, n); });
+    std::cout << "MCx lanes: " << (sizeof(typename State::board_type) == 8 ? playout_lanes() : 1) << std::endl;
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    Options opt;
+    bool status = parse_argv(argc, argv,
+                             Arg<int>("--depth", opt.depth, 8, true),
+                             Arg<int>("--samples", opt.samples, 2000, true),
+                             Arg<unsigned>("--seed", opt.seed, 1, true),
+                             Arg<bool>("--incremental", opt.incremental, true),
+                             Arg<bool>("--ordering", opt.ordering, true),
+                             Arg<int>("--tt", opt.tt, 0, true),
+                             Arg<double>("--time", opt.time, 0, true),
+                             Arg<bool>("--solve", opt.solve, true),
+                             Arg<bool>("--hard", opt.hard, true),
+                             Arg<bool>("--exact", opt.exact, true),
+                             Arg<std::string>("--position", opt.position, "", true),
+                             Arg<int>("--threads", opt.threads, 0, true),
+                             Arg<bool>("--ybw", opt.ybw, true),
+                             Arg<int>("--split", opt.split, 8, true),
+                             Arg<bool>("--replay", opt.replay, true),
+                             Arg<int>("--aspiration", opt.aspiration, ASPIRATION, true),
+                             Arg<bool>("--session", opt.session, true),
+                             Arg<std::string>("--load", opt.load, "", true),
+                             Arg<std::string>("--save", opt.save, "", true),
+                             Arg<bool>("--read-only", opt.read_only, true),
+                             Arg<std::string>("--shm", opt.shm, "", true),
+                             Arg<bool>("--shm-remove", opt.shm_remove, true),
+                             Arg<bool>("--small-pages", opt.small_pages, true),
+                             Arg<bool>("--deadlines", opt.deadlines, true),
+                             Arg<std::string>("--board", opt.board, "7x6", true)
+                             );
+    if (!status) return 1;
+
+    playout_rng().seed(opt.seed);
+    if (opt.board == "7x6") return bench<State>(opt);
+    if (opt.board == "8x7") return bench<BasicState<8,7>>(opt);
+    if (opt.board == "9x7") return bench<BasicState<9,7>>(opt);
+    std::cerr << "error: unsupported board " << opt.board << " (7x6, 8x7 or 9x7)" << std::endl;
+    return 1;
+}
@@ -1,15 +1,91 @@
 #include "connect4.hpp"
-#include <ostream>
+#include <cstdlib>
+#include <iostream>
 
-void State::dump(std::ostream& s) const
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+const bool HAS_AVX2 = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+}();
+
+// four windows per vector; popcount via nibble lookup and sum of bytes,
+// weights via permute (the upper half of each 64-bit lane stays 0)
+__attribute__((target("avx2")))
+int open_windows_avx2(uint64_t b0, uint64_t b1, const uint64_t* windows, int count)
+{
+    const __m256i nibble_count = _mm256_setr_epi8(0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4,
+                                                  0,1,1,2,1,2,2,3,1,2,2,3,2,3,3,4);
+    const __m256i low_nibble = _mm256_set1_epi8(0x0F);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i weight = _mm256_setr_epi32(WINDOW_WEIGHT[0], WINDOW_WEIGHT[1], WINDOW_WEIGHT[2],
+                                             WINDOW_WEIGHT[3], WINDOW_WEIGHT[4], 0, 0, 0);
+    const auto lane_popcount = [&](__m256i x) __attribute__((target("avx2"))) {
+        const __m256i lo = _mm256_shuffle_epi8(nibble_count, _mm256_and_si256(x, low_nibble));
+        const __m256i hi = _mm256_shuffle_epi8(nibble_count,
+                                               _mm256_and_si256(_mm256_srli_epi16(x, 4), low_nibble));
+        return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), zero);
+    };
+
+    const __m256i v0 = _mm256_set1_epi64x(b0);
+    const __m256i v1 = _mm256_set1_epi64x(b1);
+    __m256i acc = zero;
+    int i = 0;
+    for (; i+4 <= count; i += 4) {
+        const __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(windows+i));
+        const __m256i n0 = lane_popcount(_mm256_and_si256(v0, w));
+        const __m256i n1 = lane_popcount(_mm256_and_si256(v1, w));
+        const __m256i val = _mm256_sub_epi32(_mm256_permutevar8x32_epi32(weight, n0),
+                                             _mm256_permutevar8x32_epi32(weight, n1));
+        const __m256i open = _mm256_or_si256(_mm256_cmpeq_epi64(n0, zero), _mm256_cmpeq_epi64(n1, zero));
+        acc = _mm256_add_epi32(acc, _mm256_and_si256(val, open));
+    }
+    __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    int val = _mm_cvtsi128_si32(sum);
+    for (; i < count; ++i)
+        val += window_score(popcount(b0 & windows[i]), popcount(b1 & windows[i]));
+    return val;
+}
+#else
+const bool HAS_AVX2 = false;
+
+int open_windows_avx2(uint64_t b0, uint64_t b1, const uint64_t* windows, int count)
 {
-    for (int i = 5; i >= 0; i--) {
-        for (int j = 0; j < 7; ++j)
+    int val = 0;
+    for (int i = 0; i < count; ++i)
+        val += window_score(popcount(b0 & windows[i]), popcount(b1 & windows[i]));
+    return val;
+}
+#endif
+
+template<int W, int H>
+void BasicState<W,H>::dump(std::ostream& s) const
+{
+    for (int i = H-1; i >= 0; i--) {
+        for (int j = 0; j < W; ++j)
             s << symbol(get(i,j)) << "  ";
         s << std::endl;
     }
-    s << "0  1  2  3  4  5  6" << std::endl;
-//        for (int i = 0; i < 7; ++i)
+    for (int j = 0; j < W; ++j)
+        s << j << (j+1 == W ? "" : j < 9 ? "  " : " ");
+    s << std::endl;
+//        for (int i = 0; i < W; ++i)
 //            s << column_height(i) << " ";
     s << " last = " << last_column() << " winner = " << winner() << std::endl;
 }
+
+template<int W, int H>
+void BasicState<W,H>::check_eval(Eval e) const
+{
+    if (e.value == heuristic_value()) return;
+    std::cerr << "eval mismatch: incremental = " << e.value
+              << " full = " << heuristic_value() << std::endl;
+    dump(std::cerr);
+    std::abort();
+}
+
+template class BasicState<7,6>;
+template class BasicState<8,7>;
+template class BasicState<9,7>;
@@ -19,6 +19,7 @@
 
 // game model implementation
 
+#include <chrono>
 #include <sstream>
 
 #include "game.h"
@@ -28,16 +29,37 @@
 
 #include "alphabeta.hpp"
 #include "mcts.hpp"
+#include "transposition.hpp"
 
 Game::Game(ViewBase& view, AudioBase& audio):
     think_algo(1),
     _view(view),
     _audio(audio),
+    _think_time(1.0),
+    _threads(1),
+    _hash_bytes(TranspositionTable::DEFAULT_BYTES),
     _msg(" ")
 {
     acRestart();
 }
 
+Game::~Game() = default;
+
+// the next search starts a new, empty table of at most that much memory
+void Game::set_hash_size(int megabytes)
+{
+    _hash_bytes = size_t(megabytes > 0 ? megabytes : 1) << 20;
+    _cache.reset();
+}
+
+// the table, for set_snapshot() to map at the next start; without one (no
+// alpha-beta move yet) there is nothing to write
+bool Game::save_snapshot() const
+{
+    if (!_cache || _snapshot.empty()) return true;
+    return _cache->save(_snapshot);
+}
+
 State Game::state() const
 {
     if (_move) return _history[_move-1];
@@ -48,28 +70,37 @@ void Game::acRestart()
 {
     _demo[0] = false; _demo[1] = true;
     _move = 0; _max_move = 0;
-    _depth = 10;
     _audio.play(AudioBase::RESTART);
     _view.update(this);
 }
 
 State Game::alphabeta_think()
 {
-    static constexpr int MIN_MOVES = 2000000;
     int moves = 0;
     State s = state();
     State q;
-    using Policy = DefaultPolicy<State>;
+    using Policy = TTPolicy<State>;
 //    using Policy = NoPolicy<State>;
-    State::score_type val = alpha_beta<State,Policy>(s, State::MINUS_INFINITY, State::PLUS_INFINITY, true,
-                                       s.next_player(), _depth, 0, &q, &moves);
-    std::stringstream ss;
-    ss << "AB(" << s.next_player() << ")" << std::endl
-       << "moves = " << moves << std::endl
-       << "depth = " << _depth << std::endl << "score = " << val;
-    _msg = ss.str();
-    _view.update(this);
-    if (moves < MIN_MOVES) ++_depth;
+    using Evaluation = IncrementalEval<State>;
+    // entries are for positions, not for the game that reached them, so they
+    // stay valid across moves, takebacks and restarts
+    // mapped copy-on-write from the snapshot if it fits this board and
+    // scoring, else new
+    if (!_cache && !_snapshot.empty()) _cache = Policy::mapped(_snapshot, TranspositionTable::COPY_ON_WRITE);
+    if (!_cache) _cache.reset(new Policy(_hash_bytes));
+    Policy& cache = *_cache;
+    cache.new_search();
+    auto t0 = std::chrono::steady_clock::now();
+    auto report = [&](int depth, State::score_type val, const State&, int) {
+        std::chrono::duration<double> dur = std::chrono::steady_clock::now()-t0;
+        std::stringstream ss;
+        ss << "AB(" << s.next_player() << ") " << dur.count() << 's' << std::endl
+           << "moves = " << moves << std::endl
+           << "depth = " << depth << std::endl << "score = " << val;
+        _msg = ss.str();
+        _view.update(this);
+    };
+    lazy_smp<State,Policy,Evaluation>(s, cache, _think_time, State::MAX_DEPTH, _threads, &q, &moves, report);
     return q;
 }
 
@@ -80,11 +111,11 @@ State Game::mcts_think()
     State s = state();
     auto t0 = std::chrono::steady_clock::now();
 
-    mcts::Tree<State,42> tree(s);
+    mcts::Tree<State,State::MAX_DEPTH> tree(s);
 
-    State q = mcts::naive_analyze<7>(s, NUM_SAMPLES, s.next_player(), &val);
+    State q = mcts::naive_analyze<State::WIDTH>(s, NUM_SAMPLES, s.next_player(), &val);
 
-    auto sel = mcts::select<7>( tree );
+    auto sel = mcts::select<State::WIDTH>( tree );
     sel.state.dump( std::cerr );
     auto sel2 = mcts::expand( tree, sel );
     sel2.dump( std::cerr );
@@ -118,7 +149,7 @@ bool Game::acPlay(int where)
             _audio.play(AudioBase::LOSER);
         _view.update(this);
         return true;
-    } else if (s.column_height(where) < 6) { // human play
+    } else if (s.column_height(where) < State::HEIGHT) { // human play
         auto sampleIndex = static_cast<AudioBase::e_sample>(s.column_height(where)+1);
         _audio.play(sampleIndex);
         _history[_move++] = s.make_move(where, s.next_player());
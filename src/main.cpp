@@ -31,6 +31,7 @@
 #include "frameratecontroller.h"
 #include "arguments.hpp"
 #include "connect4.hpp"
+#include "xoshiro.hpp"
 
 #include <SFML/Window/Event.hpp>
 #include <SFML/Window/Keyboard.hpp>
@@ -39,7 +40,6 @@
 #include <vector>
 #include <iostream>
 #include <string>
-#include <cstdlib>
 #include <ctime>
 
 
@@ -48,6 +48,10 @@ struct Options
     bool windowed = false;
     int frame_rate = 15;
     bool demo = false;
+    double think = 1.0; // seconds per alpha-beta move
+    int threads = 1; // alpha-beta search threads
+    int hash = 64; // MB of alpha-beta transposition table
+    std::string snapshot; // file of the table, read at start and written at exit
 };
 
 int main(int argc, char **argv)
@@ -62,15 +66,23 @@ int main(int argc, char **argv)
     bool status = parse_argv(argc, argv,
                              Arg<bool>("--nofs", opt.windowed, true),
                              Arg<int>("--fps", opt.frame_rate, 15, true),
-                             Arg<bool>("--demo", opt.demo, true)
+                             Arg<bool>("--demo", opt.demo, true),
+                             Arg<double>("--think", opt.think, 1.0, true),
+                             Arg<int>("--threads", opt.threads, 1, true),
+                             Arg<int>("--hash", opt.hash, 64, true),
+                             Arg<std::string>("--snapshot", opt.snapshot, "", true)
                              );
     if (!status) return 1;
 
     GameView gv(!opt.windowed);
 	AudioInterface aud;
     Game game(gv, aud);
+    game.set_think_time(opt.think);
+    game.set_threads(opt.threads);
+    game.set_hash_size(opt.hash);
+    game.set_snapshot(opt.snapshot);
 
-    std::srand(std::time(NULL));
+    playout_rng().seed(std::time(NULL));
 
     auto win = gv.getWindow();
     FrameRateController fps{opt.frame_rate};
@@ -162,6 +174,8 @@ int main(int argc, char **argv)
         fps();
         if (game.is_demo(game.state().next_player())) game.acPlay();
     }
+    if (!opt.snapshot.empty() && !game.save_snapshot())
+        std::cerr << "error: cannot write snapshot " << opt.snapshot << std::endl;
     return 0;
 }
 
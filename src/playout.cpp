@@ -0,0 +1,320 @@
+#include "playout.h"
+#include "geometry.hpp"
+
+// Every lane plays its share of the games from the root position, one move
+// per step: take an immediate win if there is one, otherwise drop into the
+// k-th playable column, k uniform.  Per 64-bit lane the playable cells have
+// at most one bit per column byte, so the k-th one is found with a prefix
+// sum of the non-empty bytes instead of a bit scan.  Each lane has its own
+// xoshiro256** state, drawn from the caller's generator.
+
+namespace {
+
+constexpr uint64_t BYTE_ONES = 0x0101010101010101;
+
+// cells (empty or not) that would complete four in a row in b;
+// the scalar form of BasicState::completions()
+uint64_t completions(uint64_t b)
+{
+    uint64_t r = (b << 1) & (b << 2) & (b << 3);
+    for (int shift: {8, 9, 7}) {
+        uint64_t p = (b << shift) & (b << 2*shift);
+        r |= p & (b << 3*shift);
+        r |= p & (b >> shift);
+        p = (b >> shift) & (b >> 2*shift);
+        r |= p & (b << shift);
+        r |= p & (b >> 3*shift);
+    }
+    return r;
+}
+
+void playouts_scalar(uint64_t root_mine, uint64_t root_occ, uint64_t cells,
+                     int num_samples, Xoshiro256& rng, int wins[2])
+{
+    const uint64_t bottom = cells & BYTE_ONES;
+    for (int i = 0; i < num_samples; ++i) {
+        uint64_t mine = root_mine, occ = root_occ;
+        int who = 0;
+        while (true) {
+            uint64_t play = (occ + bottom) & cells;
+            if (!play) break;
+            if (play & completions(mine)) { ++wins[who]; break; }
+            for (unsigned k = rng.below(popcount(play)); k; --k) play &= play - 1;
+            mine ^= occ;
+            occ |= play & (~play + 1);
+            who ^= 1;
+        }
+    }
+}
+
+// games per lane: an even share, the first lanes taking the remainder
+template<int LANES>
+void share(int num_samples, int64_t left[LANES])
+{
+    for (int i = 0; i < LANES; ++i) left[i] = num_samples/LANES + (i < num_samples%LANES);
+}
+
+} // namespace
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+
+namespace {
+
+const int PLAYOUT_LANES = [] {
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return 16;
+    if (__builtin_cpu_supports("avx2")) return 8;
+    return 1;
+}();
+
+// AVX2: four games per vector, U vectors interleaved to hide latency;
+// &, |, ^ and + are the GCC vector operators on 64-bit lanes
+
+#define AVX2 __attribute__((target("avx2"), always_inline)) inline
+
+template<int S> AVX2 __m256i shl(__m256i x) { return __m256i(__v4du(x) << S); }
+template<int S> AVX2 __m256i shr(__m256i x) { return __m256i(__v4du(x) >> S); }
+
+template<int S> AVX2 __m256i completions_dir(__m256i b)
+{
+    __m256i p = shl<S>(b) & shl<2*S>(b);
+    __m256i r = (p & shl<3*S>(b)) | (p & shr<S>(b));
+    p = shr<S>(b) & shr<2*S>(b);
+    return r | (p & shl<S>(b)) | (p & shr<3*S>(b));
+}
+
+AVX2 __m256i completions(__m256i b)
+{
+    return (shl<1>(b) & shl<2>(b) & shl<3>(b))
+        | completions_dir<8>(b) | completions_dir<9>(b) | completions_dir<7>(b);
+}
+
+template<int S> AVX2 __m256i rotl(__m256i x) { return shl<S>(x) | shr<64-S>(x); }
+
+struct Rng4 { __m256i s[4]; };
+
+AVX2 __m256i next(Rng4& g)
+{
+    const __m256i x = g.s[1] + shl<2>(g.s[1]); // * 5
+    const __m256i r7 = rotl<7>(x);
+    const __m256i result = r7 + shl<3>(r7); // * 9
+    const __m256i t = shl<17>(g.s[1]);
+    g.s[2] = g.s[2] ^ g.s[0];
+    g.s[3] = g.s[3] ^ g.s[1];
+    g.s[1] = g.s[1] ^ g.s[2];
+    g.s[0] = g.s[0] ^ g.s[3];
+    g.s[2] = g.s[2] ^ t;
+    g.s[3] = rotl<45>(g.s[3]);
+    return result;
+}
+
+template<int U>
+__attribute__((target("avx2")))
+void playouts_avx2(uint64_t root_mine, uint64_t root_occ, uint64_t cell_mask,
+                   int num_samples, Xoshiro256& rng, int wins[2])
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i all = _mm256_set1_epi64x(-1);
+    const __m256i cells = _mm256_set1_epi64x(cell_mask);
+    const __m256i bottom = _mm256_set1_epi64x(cell_mask & BYTE_ONES);
+    const __m256i byte_ones = _mm256_set1_epi64x(BYTE_ONES);
+    const __m256i one = _mm256_set1_epi64x(1);
+    const __m256i mine0 = _mm256_set1_epi64x(root_mine);
+    const __m256i occ0 = _mm256_set1_epi64x(root_occ);
+
+    int64_t quota[4*U];
+    share<4*U>(num_samples, quota);
+    __m256i mine[U], occ[U], who[U], left[U], won[2][U];
+    Rng4 g[U];
+    for (int u = 0; u < U; ++u) {
+        mine[u] = mine0;
+        occ[u] = occ0;
+        who[u] = zero;
+        left[u] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(quota+4*u));
+        won[0][u] = won[1][u] = zero;
+        for (auto& s: g[u].s) s = _mm256_setr_epi64x(rng(), rng(), rng(), rng());
+    }
+
+    bool running = true;
+    while (running) {
+        running = false;
+        for (int u = 0; u < U; ++u) {
+            const __m256i active = _mm256_cmpgt_epi64(left[u], zero);
+            const __m256i play = (occ[u] + bottom) & cells;
+            const __m256i drawn = _mm256_cmpeq_epi64(play, zero);
+            const __m256i win = _mm256_andnot_si256(_mm256_cmpeq_epi64(play & completions(mine[u]), zero),
+                                                    active);
+            const __m256i done = (drawn & active) | win;
+            // masks are -1 per lane
+            won[1][u] = _mm256_sub_epi64(won[1][u], win & who[u]);
+            won[0][u] = _mm256_sub_epi64(won[0][u], _mm256_andnot_si256(who[u], win));
+            left[u] = left[u] + done;
+
+            // k-th playable column: non-empty bytes, their prefix count,
+            // then the first byte whose count is k+1
+            const __m256i nonempty = _mm256_cmpeq_epi8(play, zero) ^ all;
+            __m256i prefix = nonempty & byte_ones;
+            prefix = prefix + shl<8>(prefix);
+            prefix = prefix + shl<16>(prefix);
+            prefix = prefix + shl<32>(prefix);
+            const __m256i k = shr<32>(_mm256_mul_epu32(shr<32>(next(g[u])), shr<56>(prefix)));
+            __m256i target = k + one;
+            target = target | shl<8>(target);
+            target = target | shl<16>(target);
+            target = target | shl<32>(target);
+            const __m256i cell = play & nonempty & _mm256_cmpeq_epi8(prefix, target);
+
+            mine[u] = _mm256_blendv_epi8(mine[u] ^ occ[u], mine0, done);
+            occ[u] = _mm256_blendv_epi8(occ[u] | cell, occ0, done);
+            who[u] = _mm256_andnot_si256(done, who[u] ^ all);
+            running |= !_mm256_testz_si256(active, active);
+        }
+    }
+
+    alignas(32) int64_t sum[2][4];
+    for (int i = 0; i < 2; ++i) {
+        __m256i acc = won[i][0];
+        for (int u = 1; u < U; ++u) acc = acc + won[i][u];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(sum[i]), acc);
+        wins[i] += int(sum[i][0] + sum[i][1] + sum[i][2] + sum[i][3]);
+    }
+}
+
+#undef AVX2
+
+// AVX-512: the same with eight games per vector and mask registers for
+// the lane conditions
+
+#define AVX512 __attribute__((target("avx512f,avx512bw"), always_inline)) inline
+
+template<int S> AVX512 __m512i shl(__m512i x) { return __m512i(__v8du(x) << S); }
+template<int S> AVX512 __m512i shr(__m512i x) { return __m512i(__v8du(x) >> S); }
+
+template<int S> AVX512 __m512i completions_dir(__m512i b)
+{
+    __m512i p = shl<S>(b) & shl<2*S>(b);
+    __m512i r = (p & shl<3*S>(b)) | (p & shr<S>(b));
+    p = shr<S>(b) & shr<2*S>(b);
+    return r | (p & shl<S>(b)) | (p & shr<3*S>(b));
+}
+
+AVX512 __m512i completions(__m512i b)
+{
+    return (shl<1>(b) & shl<2>(b) & shl<3>(b))
+        | completions_dir<8>(b) | completions_dir<9>(b) | completions_dir<7>(b);
+}
+
+template<int S> AVX512 __m512i rotl(__m512i x) { return shl<S>(x) | shr<64-S>(x); }
+
+struct Rng8 { __m512i s[4]; };
+
+AVX512 __m512i next(Rng8& g)
+{
+    const __m512i x = g.s[1] + shl<2>(g.s[1]); // * 5
+    const __m512i r7 = rotl<7>(x);
+    const __m512i result = r7 + shl<3>(r7); // * 9
+    const __m512i t = shl<17>(g.s[1]);
+    g.s[2] = g.s[2] ^ g.s[0];
+    g.s[3] = g.s[3] ^ g.s[1];
+    g.s[1] = g.s[1] ^ g.s[2];
+    g.s[0] = g.s[0] ^ g.s[3];
+    g.s[2] = g.s[2] ^ t;
+    g.s[3] = rotl<45>(g.s[3]);
+    return result;
+}
+
+template<int U>
+__attribute__((target("avx512f,avx512bw")))
+void playouts_avx512(uint64_t root_mine, uint64_t root_occ, uint64_t cell_mask,
+                     int num_samples, Xoshiro256& rng, int wins[2])
+{
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i cells = _mm512_set1_epi64(cell_mask);
+    const __m512i bottom = _mm512_set1_epi64(cell_mask & BYTE_ONES);
+    const __m512i byte_ones = _mm512_set1_epi64(BYTE_ONES);
+    const __m512i one = _mm512_set1_epi64(1);
+    const __m512i mine0 = _mm512_set1_epi64(root_mine);
+    const __m512i occ0 = _mm512_set1_epi64(root_occ);
+
+    int64_t quota[8*U];
+    share<8*U>(num_samples, quota);
+    __m512i mine[U], occ[U], left[U], won[2][U];
+    __mmask8 who[U];
+    Rng8 g[U];
+    for (int u = 0; u < U; ++u) {
+        mine[u] = mine0;
+        occ[u] = occ0;
+        who[u] = 0;
+        left[u] = _mm512_loadu_si512(quota+8*u);
+        won[0][u] = won[1][u] = zero;
+        for (auto& s: g[u].s) s = _mm512_setr_epi64(rng(), rng(), rng(), rng(), rng(), rng(), rng(), rng());
+    }
+
+    bool running = true;
+    while (running) {
+        running = false;
+        for (int u = 0; u < U; ++u) {
+            const __mmask8 active = _mm512_cmpgt_epi64_mask(left[u], zero);
+            const __m512i play = (occ[u] + bottom) & cells;
+            const __mmask8 drawn = _mm512_mask_cmpeq_epi64_mask(active, play, zero);
+            const __mmask8 win = _mm512_mask_test_epi64_mask(active, play, completions(mine[u]));
+            const __mmask8 done = drawn | win;
+            won[1][u] = _mm512_mask_add_epi64(won[1][u], win & who[u], won[1][u], one);
+            won[0][u] = _mm512_mask_add_epi64(won[0][u], win & ~who[u], won[0][u], one);
+            left[u] = _mm512_mask_sub_epi64(left[u], done, left[u], one);
+
+            const __mmask64 nonempty = _mm512_test_epi8_mask(play, play);
+            __m512i prefix = _mm512_maskz_mov_epi8(nonempty, byte_ones);
+            prefix = prefix + shl<8>(prefix);
+            prefix = prefix + shl<16>(prefix);
+            prefix = prefix + shl<32>(prefix);
+            const __m512i k = shr<32>(_mm512_mul_epu32(shr<32>(next(g[u])), shr<56>(prefix)));
+            __m512i target = k + one;
+            target = target | shl<8>(target);
+            target = target | shl<16>(target);
+            target = target | shl<32>(target);
+            const __m512i cell = _mm512_maskz_mov_epi8(_mm512_mask_cmpeq_epi8_mask(nonempty, prefix, target), play);
+
+            mine[u] = _mm512_mask_mov_epi64(mine[u] ^ occ[u], done, mine0);
+            occ[u] = _mm512_mask_mov_epi64(occ[u] | cell, done, occ0);
+            who[u] = ~who[u] & ~done;
+            running |= active != 0;
+        }
+    }
+
+    for (int i = 0; i < 2; ++i) {
+        __m512i acc = won[i][0];
+        for (int u = 1; u < U; ++u) acc = acc + won[i][u];
+        wins[i] += int(_mm512_reduce_add_epi64(acc));
+    }
+}
+
+#undef AVX512
+
+} // namespace
+
+int playout_lanes()
+{
+    return PLAYOUT_LANES;
+}
+
+void batch_playouts(uint64_t mine, uint64_t occ, uint64_t cell_mask,
+                    int num_samples, Xoshiro256& rng, int wins[2])
+{
+    if (PLAYOUT_LANES == 16) playouts_avx512<2>(mine, occ, cell_mask, num_samples, rng, wins);
+    else if (PLAYOUT_LANES == 8) playouts_avx2<2>(mine, occ, cell_mask, num_samples, rng, wins);
+    else playouts_scalar(mine, occ, cell_mask, num_samples, rng, wins);
+}
+#else
+int playout_lanes()
+{
+    return 1;
+}
+
+void batch_playouts(uint64_t mine, uint64_t occ, uint64_t cell_mask,
+                    int num_samples, Xoshiro256& rng, int wins[2])
+{
+    playouts_scalar(mine, occ, cell_mask, num_samples, rng, wins);
+}
+#endif